@@ -31,10 +31,13 @@ void matrix_multiplication() {
       });
   mcl::Timer timer;
   const int size = 2048;
-  mcl::Environment env;
+  mcl::Environment env(mcl::Environment::Options{.profiling = true});
   mcl::Memory<2, float> A(&env, size, size, 3);
   mcl::Memory<2, float> B(&env, size, size, 4);
   mcl::Memory<2, float> C(&env, size, size);
+  A.set_name("A");
+  B.set_name("B");
+  C.set_name("C");
   std::cout << "--- Matrix Multiplication ---\n";
   std::cout << "Matrix size: " << size << "x" << size << " (" + std::to_string(A.mem_size() / 1024 / 1024) + " MiB)"
             << std::endl;
@@ -43,8 +46,11 @@ void matrix_multiplication() {
   auto kernel = env.add_kernel(cl::NDRange(size, size), "mmul", mmul);
   kernel.set_parameters(A, B, C);           // pointer arguments
   kernel.set_args(size, size, size, size);  // integer arguments
+  kernel.set_work_per_run(2ULL * size * size * size);
   A.write_to_device();
   B.write_to_device();
+  // picks the fastest 2D local range (stored in the TuningDatabase, later runs reuse it without benchmarking)
+  kernel.autotune();
   std::cout << "  Computing Matrix Product:" << std::endl;
   std::cout << "                    C[0][0] ... C[512][0] ... C[1023][0]" << std::endl;
   std::cout << "    initial values:    " << C[0] << "    ...     " << C[512] << "     ...     " << C[1023] << std::endl;
@@ -54,16 +60,23 @@ void matrix_multiplication() {
   C.read_from_device();
   std::cout << "    result:          " << C[0] << "  ...   " << C[512] << "   ...    " << C[1023] << std::endl;
   std::cout << "  Computation time: " << dur << std::endl;
+  std::cout << "  Device timings:" << std::endl;
+  env.get_profiler().print(std::cout);
+  env.get_profiler().write_chrome_trace("mmul_trace.json", env.get_device()->name());
+  std::cout << "  Timeline written to mmul_trace.json (open with chrome://tracing or ui.perfetto.dev)" << std::endl;
 }
 
 void vector_addition() {
   KERNEL_CODE(
-      vadd, __kernel void vadd(__global const float* A, __global const float* B, __global float* C) {
+      vadd, __kernel void vadd(__global const float* A, __global const float* B, __global float* C,
+                               MCL_RANGE_PARAMETERS) {
+        MCL_RANGE_GUARD;
         int i = get_global_id(0);
         C[i] = A[i] + B[i];
       });
   mcl::Timer timer;
-  size_t size = 1024 << 8;
+  // not a multiple of the work group size: the global range is padded and the padding is discarded by MCL_RANGE_GUARD
+  size_t size = (1024 << 8) + 3;
   mcl::Environment env;
   mcl::Memory<1, float> A(&env, size, 3);
   mcl::Memory<1, float> B(&env, size, 4);
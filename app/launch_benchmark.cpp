@@ -0,0 +1,81 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/opencl.h>
+#include <missocl/utils.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+/**
+ * Measures the host side launch rate of a tiny kernel:
+ *  - Kernel::run() per launch (enqueue and finish every launch)
+ *  - Kernel::enqueue_run(launches) and a single finish
+ *  - LaunchBatch::run() with all launches in one batch
+ *  - a persistent kernel processing one work item per launch of the other variants in a single launch
+ */
+int main(int argc, char** argv) {
+  KERNEL_CODE(
+      tiny, __kernel void tiny(__global uint* a) { a[get_global_id(0)] += 1; }
+
+      __kernel void tiny_persistent(__global uint* a, MCL_WORK_QUEUE_PARAMETERS) {
+        MCL_FOR_EACH_WORK_ITEM(item) { atomic_inc(&a[item % 64]); }
+      });
+  const unsigned launches = argc > 1 ? std::stoul(argv[1]) : 10000;
+  const unsigned repetitions = 5;
+
+  mcl::Environment env;
+  mcl::Memory<1, cl_uint> a(&env, 64, 0, mcl::MemoryPolicy::DEVICE_ONLY);
+  auto kernel = env.add_kernel(cl::NDRange(64), "tiny", tiny);
+  kernel.set_parameters(a);
+  auto persistent = env.add_kernel(cl::NDRange(64), "tiny_persistent", tiny);
+  persistent.set_parameters(a);
+  // just enough work items to fill the device
+  persistent.set_range(cl::NDRange(env.get_device()->compute_units() * 4 * WORKGROUP_SIZE));
+
+  std::cout << "--- Launch Benchmark ---\n";
+  std::cout << "Device:   " << *env.get_device() << std::endl;
+  std::cout << "Launches: " << launches << " (best of " << repetitions << ")" << std::endl;
+  std::cout << "------------------------\n";
+
+  auto measure = [&](const std::string& name, const auto& f) {
+    f();  // warm up
+    double best = 0;
+    for (unsigned r = 0; r < repetitions; ++r) {
+      mcl::Timer timer;
+      timer.start();
+      f();
+      double seconds = timer.stop().count();
+      best = r == 0 ? seconds : std::min(best, seconds);
+    }
+    std::cout << "  " << std::left << std::setw(28) << name << std::right << std::setw(14) << std::fixed
+              << std::setprecision(0) << launches / best << " launches/s" << std::endl;
+  };
+
+  measure("Kernel::run()", [&]() {
+    for (unsigned i = 0; i < launches; ++i) {
+      kernel.run();
+    }
+  });
+  measure("Kernel::enqueue_run(t)", [&]() {
+    kernel.enqueue_run(launches);
+    kernel.finish_queue();
+  });
+  mcl::LaunchBatch batch(env);
+  batch.add(kernel, launches);
+  measure("LaunchBatch::run()", [&]() { batch.run(); });
+  mcl::LaunchBatch persistent_batch(env);
+  persistent_batch.add_persistent(persistent, 1, launches);
+  measure("persistent kernel (items/s)", [&]() { persistent_batch.run(); });
+  return 0;
+}
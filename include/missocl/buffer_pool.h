@@ -0,0 +1,98 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+#endif
+#define CL_HPP_ENABLE_EXCEPTIONS
+#include <CL/opencl.hpp>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace mcl {
+
+// ===== BufferPool ====================================================================================================
+/**
+ * @brief Recycles device buffers of released mcl::Memory objects.
+ *
+ *        Requested sizes are rounded up to a size class (four classes per power of two, at least 256 Bytes), so that
+ *        a released buffer can serve any later request of the same class and the same cl_mem_flags. Released buffers
+ *        are cached until trim() is called. All buffers of a pool must belong to the same context.
+ *
+ *        The pool of an Environment is enabled by Environment::Options::buffer_pool. Buffers are handed out again as
+ *        soon as they are released: commands that still use a released buffer must be enqueued to the same in-order
+ *        queue as the commands of its next owner, or be finished before. Environments therefore only pool buffers if
+ *        they have a single in-order queue (commands enqueued to other Environments, e.g. by Memory::copy_to(...),
+ *        must still be finished before the buffer is released).
+ */
+class BufferPool {
+ public:
+  struct Statistics {
+    /// buffers allocated from the driver
+    uint64_t allocations{0};
+    /// requests served by a cached buffer
+    uint64_t reuses{0};
+    /// Bytes requested by the buffers in use
+    uint64_t requested_Bytes{0};
+    /// size (size class) of the buffers in use
+    uint64_t in_use_Bytes{0};
+    /// size of the cached buffers
+    uint64_t cached_Bytes{0};
+    /// maximum of in_use_Bytes + cached_Bytes
+    uint64_t high_water_Bytes{0};
+
+    /**
+     * @brief Returns the share of the allocated Bytes that is not requested: rounding to size classes and cached
+     *        buffers (0 if nothing is allocated).
+     */
+    [[nodiscard]] double fragmentation() const;
+  };
+
+  /**
+   * @brief Returns a cached buffer of at least size_Bytes with flags, or a null buffer if none is cached.
+   */
+  cl::Buffer acquire(size_t size_Bytes, cl_mem_flags flags);
+
+  /**
+   * @brief Allocates a new buffer of size_class(size_Bytes) Bytes with flags in context, which is then in use.
+   */
+  cl::Buffer allocate(const cl::Context& context, size_t size_Bytes, cl_mem_flags flags);
+
+  /**
+   * @brief Returns buffer, which was acquired with size_Bytes and flags, to the pool.
+   */
+  void release(cl::Buffer buffer, size_t size_Bytes, cl_mem_flags flags);
+
+  /**
+   * @brief Frees all cached buffers and returns their size.
+   */
+  size_t trim();
+
+  [[nodiscard]] Statistics statistics() const;
+
+  /**
+   * @brief Returns the size class of size_Bytes: the size of the buffers allocated for it.
+   */
+  static size_t size_class(size_t size_Bytes);
+
+ private:
+  mutable std::mutex _mutex;
+  /// cached buffers by flags and size class
+  std::map<std::pair<cl_mem_flags, size_t>, std::vector<cl::Buffer>> _cached;
+  Statistics _statistics;
+};
+
+}  // namespace mcl
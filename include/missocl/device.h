@@ -16,8 +16,17 @@
 #endif
 #define CL_HPP_ENABLE_EXCEPTIONS
 #include <CL/opencl.hpp>
+#include <atomic>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
 
 namespace mcl {
 
@@ -26,9 +35,8 @@ namespace mcl {
  *        It provides instant methods for retrieving common data.
  */
 class Device {
-  template <unsigned dimension, typename T>
-  friend class Memory;
   friend class DeviceManager;
+  friend class Environment;
   friend std::ostream& operator<<(std::ostream& os, const Device& device);
 
  public:
@@ -99,10 +107,39 @@ class Device {
    * @brief Returns the amount of memory used in Bytes.
    *
    *        This value is only correct, if the mcl::Memory object was used for memory management and if this Device was
-   *        correctly passed to the mcl::Memory instance.
+   *        correctly passed to the mcl::Memory instance. Buffers cached by a BufferPool are counted as used.
+   *        Allocations on sub-devices (see partition_by_numa()) are also counted by their parent device.
    */
   [[nodiscard]] uint64_t memory_used_Bytes() const;
 
+  /**
+   * @brief Returns the maximum of memory_used_Bytes() since construction or the last reset_memory_peak().
+   */
+  [[nodiscard]] uint64_t memory_peak_Bytes() const;
+  void reset_memory_peak();
+
+  /**
+   * @brief Called if an allocation of requested_Bytes would exceed the memory budget. Must return true if memory was
+   *        released and the allocation should be retried, false to let the allocation fail.
+   */
+  using BudgetCallback = std::function<bool(Device& device, uint64_t requested_Bytes)>;
+
+  /**
+   * @brief Limits the memory allocated through mcl::Memory on this device to budget_Bytes (0: no limit).
+   *
+   *        An allocation that would exceed the budget first releases the cached buffers of its Environment's
+   *        BufferPool, then calls callback (if set) and finally throws mcl::MemoryBudgetError before the driver is
+   *        asked for memory. The budget of a device also limits the allocations on its sub-devices.
+   */
+  void set_memory_budget(uint64_t budget_Bytes, BudgetCallback callback = nullptr);
+  [[nodiscard]] uint64_t memory_budget_Bytes() const;
+
+  /**
+   * @brief Returns the Bytes that can still be allocated: the budget (or memory_Bytes() if no budget is set) minus
+   *        memory_used_Bytes().
+   */
+  [[nodiscard]] uint64_t memory_available_Bytes() const;
+
   /**
    * @brief Returns the size of the global cache in Bytes.
    */
@@ -118,6 +155,12 @@ class Device {
    */
   [[nodiscard]] uint64_t max_global_buffer_Bytes() const;
 
+  /**
+   * @brief Returns the alignment in Bytes host pointers need for CL_MEM_USE_HOST_PTR buffers to be used without copy
+   *        (CL_DEVICE_MEM_BASE_ADDR_ALIGN).
+   */
+  [[nodiscard]] uint32_t memory_alignment_Bytes() const;
+
   /**
    * @brief Returns the size of the constant buffer in Bytes.
    */
@@ -193,22 +236,108 @@ class Device {
    */
   [[nodiscard]] uint64_t estimated_flops() const;
 
+  /**
+   * @brief Throughput numbers of the device, measured with short microbenchmarks by Device::characterize(...).
+   */
+  struct Characteristics {
+    /// single precision FMA throughput in FLOPS/second (an FMA counts as two operations)
+    double flops{0};
+    /// copy bandwidth of global memory in Bytes/second (read and written Bytes)
+    double global_Bytes_per_s{0};
+    /// read bandwidth of local memory in Bytes/second
+    double local_Bytes_per_s{0};
+    /// transfer bandwidth from pageable host memory to the device in Bytes/second
+    double write_Bytes_per_s{0};
+    /// transfer bandwidth from the device to pageable host memory in Bytes/second
+    double read_Bytes_per_s{0};
+  };
+
+  /**
+   * @brief Returns the measured characteristics of the device.
+   *
+   *        The results are cached per device name, vendor and driver version in the file set by
+   *        Device::set_characteristics_file(...). The microbenchmarks (about a second per device) only run if no cached
+   *        result exists or if force is true. Throws mcl::OpenCLError if a microbenchmark fails.
+   */
+  const Characteristics& characterize(bool force = false);
+
+  /**
+   * @brief Returns the characteristics measured in this process or cached on disk, without running any benchmark.
+   */
+  [[nodiscard]] std::optional<Characteristics> characteristics() const;
+
+  /**
+   * @brief Sets the file measured characteristics are persisted to. An empty path keeps them in memory only. The
+   *        initial file is mcl::default_cache_directory() / "devices.db".
+   */
+  static void set_characteristics_file(std::filesystem::path file);
+  static std::filesystem::path get_characteristics_file();
+
   [[nodiscard]] bool intel_gt_4gb_buffer_required() const;
 
+  /**
+   * @brief Partitions the device into one sub-device per NUMA node (clCreateSubDevices with
+   *        CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN and CL_DEVICE_AFFINITY_DOMAIN_NUMA).
+   *
+   *        Sub-devices are Devices of their own: they are registered in the DeviceManager (DeviceManager::get<ID>(...),
+   *        not included in the other filters) and can be used by an Environment. An Environment on a CPU sub-device
+   *        keeps its work on the cores of one NUMA node, see also MemoryPolicy::ZERO_COPY for NUMA local host memory.
+   *        Partitioning a device the same way again returns the same sub-devices. Throws std::runtime_error if the
+   *        device does not support the partition and mcl::OpenCLError if clCreateSubDevices fails.
+   */
+  std::vector<Device*> partition_by_numa();
+
+  /**
+   * @brief Partitions the device into as many sub-devices with compute_units compute units each as possible
+   *        (clCreateSubDevices with CL_DEVICE_PARTITION_EQUALLY). See partition_by_numa().
+   */
+  std::vector<Device*> partition_equally(uint32_t compute_units);
+
+  /**
+   * @brief Returns the Device this sub-device was partitioned from, nullptr for a root device.
+   */
+  [[nodiscard]] Device* get_parent() const;
+  [[nodiscard]] bool is_sub_device() const;
+
  private:
   uint64_t _compute_cores();
+  std::vector<Device*> _partition(const std::vector<cl_device_partition_property>& properties);
+  /// runs the microbenchmarks of characterize(...)
+  Characteristics _measure();
+  /// key of the device in the characteristics file
+  [[nodiscard]] std::string _characteristics_key() const;
+
+  /// adds size_Bytes to the used memory of this device and its parents if all budgets allow it
+  bool _try_reserve_memory(uint64_t size_Bytes);
+  /// adds size_Bytes to the used memory of this device and its parents, calls the budget callbacks or throws
+  /// MemoryBudgetError if a budget is exceeded
+  void _reserve_memory(uint64_t size_Bytes);
+  void _release_memory(uint64_t size_Bytes);
+  /// adds size_Bytes to the used memory of this device only if its budget allows it
+  bool _try_reserve_own_memory(uint64_t size_Bytes);
 
   /// set by constructor
   cl::Device _cl_device;
 
   /// set by constructor
   uint32_t _id;
+  /// set by DeviceManager for sub-devices
+  Device* _parent{nullptr};
   /// set by constructor
   uint32_t _instructions_per_cycle;
   /// set by constructor via _compute_cores()
   uint64_t _cores;
-  /// set by mcl::Memory
-  uint64_t _memory_used_Bytes{0};
+  /// set by mcl::Environment for all mcl::Memory buffers
+  std::atomic<uint64_t> _memory_used_Bytes{0};
+  std::atomic<uint64_t> _memory_peak_Bytes{0};
+  /// 0: no budget
+  std::atomic<uint64_t> _memory_budget_Bytes{0};
+  BudgetCallback _budget_callback;
+  std::mutex _budget_mutex;
+
+  /// set by characterize(...) or loaded from the characteristics file by characteristics()
+  mutable std::optional<Characteristics> _characteristics;
+  mutable std::mutex _characteristics_mutex;
 
   /// set by _compute_cores()
   bool _intel_gt_4gb_buffer_required{false};
@@ -234,17 +363,23 @@ std::ostream& operator<<(std::ostream& os, const Device::Type& type);
  * @brief enum values used to retrieve specific devices using the mcl::DeviceManager
  */
 enum class Filter {
-  MAX_MEMORY,  // Device with most memory
-  MIN_MEMORY,  // Device with the smallest memory
-  MAX_FLOPS,   // Device with most estimated FLOPS
-  MIN_FLOPS,   // Device with least estimated FLOPS
-  GPU,         // All GPU devices
-  CPU,         // ALL CPU devices
-  ID,          // Device by ID
-  ALL          // All Devices
+  MAX_MEMORY,              // Device with most memory
+  MIN_MEMORY,              // Device with the smallest memory
+  MAX_FLOPS,               // Device with most FLOPS: measured if all devices have characteristics, else estimated
+  MIN_FLOPS,               // Device with least FLOPS: measured if all devices have characteristics, else estimated
+  MAX_MEASURED_FLOPS,      // Device with most measured FLOPS (characterizes all devices)
+  MIN_MEASURED_FLOPS,      // Device with least measured FLOPS (characterizes all devices)
+  MAX_MEASURED_BANDWIDTH,  // Device with the highest measured global memory bandwidth (characterizes all devices)
+  MIN_MEASURED_BANDWIDTH,  // Device with the lowest measured global memory bandwidth (characterizes all devices)
+  GPU,                     // All GPU devices
+  CPU,                     // ALL CPU devices
+  ID,                      // Device by ID
+  ALL                      // All Devices
 };
 
 class DeviceManager {
+  friend class Device;
+
  public:
   /**
    * @brief Used to retrieve one specific device.
@@ -254,6 +389,10 @@ class DeviceManager {
    *            MIN_MEMORY
    *            MAX_FLOPS
    *            MIN_FLOPS
+   *            MAX_MEASURED_FLOPS
+   *            MIN_MEASURED_FLOPS
+   *            MAX_MEASURED_BANDWIDTH
+   *            MIN_MEASURED_BANDWIDTH
    */
   template <Filter T>
   static Device* get();
@@ -270,7 +409,7 @@ class DeviceManager {
   static std::vector<Device*> get_list();
 
   /**
-   * @brief Used to retrieve one specific device by id (= value).
+   * @brief Used to retrieve one specific device (or sub-device, see Device::partition_by_numa()) by id (= value).
    *
    *        This method is implemented for
    *        T = ID
@@ -282,7 +421,14 @@ class DeviceManager {
   DeviceManager();
   static DeviceManager& get_instance();
 
+  /// creates (or returns the already created) sub-devices of parent
+  std::vector<Device*> _sub_devices_of(Device& parent, const std::vector<cl_device_partition_property>& properties);
+
   std::vector<Device> _devices;
+  /// sub-devices get the ids following the root devices; a deque keeps them in place while new ones are added
+  std::deque<Device> _sub_devices;
+  std::map<std::pair<uint32_t, std::vector<cl_device_partition_property>>, std::vector<Device*>> _partitions;
+  std::mutex _sub_devices_mutex;
 };
 
 }  // namespace mcl
\ No newline at end of file
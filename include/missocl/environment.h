@@ -15,9 +15,18 @@
 #define CL_HPP_TARGET_OPENCL_VERSION 200
 #endif
 #include <CL/opencl.hpp>
+#include <missocl/buffer_pool.h>
+#include <missocl/profiler.h>
+
+#include <atomic>
 #include <cstdint>
-#include <string>
 #include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace mcl {
 class Kernel;
@@ -25,26 +34,214 @@ class Device;
 
 // ===== Environment ===================================================================================================
 class Environment {
-  template <unsigned dimension, typename T>
-  friend class Memory;
+  template <typename T>
+  friend class MemoryBase;
   friend class Kernel;
+  friend class StreamExecutor;
+  friend class MultiDeviceExecutor;
+  friend class TaskGraph;
+  friend class LaunchBatch;
 
  public:
+  /**
+   * @brief Configuration of the command queues of an Environment.
+   */
+  struct Options {
+    /// number of command queues created for the device. Use multiple queues to overlap transfers and kernel runs.
+    unsigned queue_count{1};
+    /// create the queues with CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE (ignored if the device does not support it)
+    bool out_of_order{false};
+    /// create the queues with CL_QUEUE_PROFILING_ENABLE and record all commands in the Profiler of the Environment
+    bool profiling{false};
+    /// recycle the device buffers of released Memory objects in a BufferPool instead of freeing them (ignored unless
+    /// queue_count is 1 and out_of_order is false)
+    bool buffer_pool{false};
+  };
+
   Environment();
   explicit Environment(Device& device);
   explicit Environment(Device* device);
+  explicit Environment(Options options);
+  Environment(Device& device, Options options);
+  Environment(Device* device, Options options);
+  ~Environment();
+
+  /**
+   * @brief Creates one Environment per entry of devices, all within one shared cl::Context.
+   *
+   *        Memory objects of any of the returned Environments can be bound to the Kernels of all others and copied or
+   *        migrated between them on the device (Memory::copy_to(...), Memory::migrate(...)) without a round trip
+   *        through the host. A device may be listed several times to get Environments with independent queues. All
+   *        devices must belong to the same platform (std::runtime_error otherwise). The Environments are independent
+   *        otherwise: every one has its own queues, programs, Profiler and BufferPool.
+   */
+  static std::vector<std::unique_ptr<Environment>> create_shared(const std::vector<Device*>& devices);
+  static std::vector<std::unique_ptr<Environment>> create_shared(const std::vector<Device*>& devices,
+                                                                 Options options);
+
+  /**
+   * @brief Returns true if this and other use the same cl::Context (see create_shared(...)).
+   */
+  [[nodiscard]] bool shares_context(const Environment& other) const;
+  [[nodiscard]] const cl::Context& get_cl_context() const;
 
+  /**
+   * @brief Creates the kernel name defined in cl_c_source.
+   *
+   *        The program of cl_c_source is built only once per Environment: adding further kernels of the same source
+   *        reuses the already built program.
+   */
   Kernel add_kernel(cl::NDRange range, std::string name, const std::string& cl_c_source);
   Kernel add_kernel(cl::NDRange range, std::string name, const std::filesystem::path& cl_c_source_file);
 
+  /**
+   * @brief Same as Environment::add_kernel(...), but the program is built on the mcl::ThreadPool::global() pool.
+   *
+   *        Building is done in parallel for different sources, concurrent requests for the same source share a single
+   *        build. The Environment must outlive the returned future.
+   */
+  std::future<Kernel> add_kernel_async(cl::NDRange range, std::string name, std::string cl_c_source);
+  std::future<Kernel> add_kernel_async(cl::NDRange range, std::string name, std::filesystem::path cl_c_source_file);
+
+  /**
+   * @brief Creates all kernels defined in cl_c_source (in the order of Environment::kernel_names(...)).
+   */
+  std::vector<Kernel> add_kernels(cl::NDRange range, const std::string& cl_c_source);
+  std::vector<Kernel> add_kernels(cl::NDRange range, const std::filesystem::path& cl_c_source_file);
+
+  /**
+   * @brief Returns the names of all kernels defined in cl_c_source (CL_PROGRAM_KERNEL_NAMES).
+   */
+  std::vector<std::string> kernel_names(const std::string& cl_c_source);
+  std::vector<std::string> kernel_names(const std::filesystem::path& cl_c_source_file);
+
+  /**
+   * @brief Returns the built program of cl_c_source. The program is built on the first call only.
+   *
+   *        Thread safe: if the program is currently built by another thread, this call waits for that build.
+   */
+  const cl::Program& get_program(const std::string& cl_c_source);
+
   [[nodiscard]] const Device* get_device() const;
 
+  /**
+   * @brief Returns the number of command queues of this Environment.
+   *
+   *        Kernel::set_queue(...) and Memory::set_queue(...) select the queue used by a Kernel or a Memory object.
+   */
+  [[nodiscard]] unsigned queue_count() const;
+
+  /**
+   * @brief Returns the command queue with index queue_index.
+   */
+  cl::CommandQueue& get_cl_queue(unsigned queue_index = 0);
+
+  /**
+   * @brief Returns true if the command queues were created with CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE.
+   *
+   *        Commands of an out-of-order queue must be ordered explicitly by event wait lists.
+   */
+  [[nodiscard]] bool out_of_order() const;
+
+  /**
+   * @brief Returns true if the Environment was created with Options::profiling.
+   */
+  [[nodiscard]] bool profiling() const;
+
+  /**
+   * @brief Returns the Profiler holding the recorded commands (empty if profiling() is false).
+   */
+  Profiler& get_profiler();
+
+  /**
+   * @brief Returns true if the Environment pools buffers (Options::buffer_pool with a single in-order queue).
+   */
+  [[nodiscard]] bool buffer_pool() const;
+
+  /**
+   * @brief Returns the allocation statistics of the BufferPool (empty if buffer_pool() is false).
+   */
+  [[nodiscard]] BufferPool::Statistics buffer_pool_statistics() const;
+
+  /**
+   * @brief Frees all buffers cached by the BufferPool.
+   */
+  void trim_buffer_pool();
+
+  /**
+   * @brief Returns the device memory allocated by the Memory objects (and the BufferPool) of this Environment. Its
+   *        share of Device::memory_used_Bytes().
+   */
+  [[nodiscard]] uint64_t memory_used_Bytes() const;
+  [[nodiscard]] uint64_t memory_peak_Bytes() const;
+
+  /**
+   * @brief Flushes all command queues.
+   */
+  void flush();
+
+  /**
+   * @brief Blocks until all commands of all command queues are finished.
+   */
+  void finish();
+
  private:
+  Environment(Device* device, Options options, cl::Context cl_context);
+
+  /// creates the queues and, unless set by create_shared(...), the context
   void _init();
+  [[nodiscard]] unsigned _checked_queue_index(unsigned queue_index) const;
+  /// records event in _profiler if profiling is enabled
+  void _record(Profiler::Record record, const cl::Event& event);
+  [[nodiscard]] std::string _build_options() const;
+  static std::string _read_source_file(const std::filesystem::path& cl_c_source_file);
+
+  /**
+   * @brief Allocates all Memory buffers: from the BufferPool if enabled and no host pointer is used, else from the
+   *        driver. Buffers that use device memory are counted in Device::memory_used_Bytes().
+   */
+  cl::Buffer _allocate_buffer(size_t size_Bytes, cl_mem_flags flags, void* host_ptr, bool device_memory);
+  /// releases a buffer of _allocate_buffer(...) called with the same size_Bytes, flags, host_ptr and device_memory
+  void _release_buffer(cl::Buffer& buffer, size_t size_Bytes, cl_mem_flags flags, void* host_ptr, bool device_memory);
+  [[nodiscard]] bool _pooled(cl_mem_flags flags, void* host_ptr) const;
+  /// counts size_Bytes as used by this Environment and its Device, enforces the memory budget of the Device
+  void _reserve_memory(uint64_t size_Bytes);
+  void _release_memory(uint64_t size_Bytes);
 
   cl::Context _cl_context{};
   Device* _device;
-  cl::CommandQueue _cl_queue{};
+  Options _options;
+  std::vector<cl::CommandQueue> _cl_queues;
+  Profiler _profiler;
+  BufferPool _buffer_pool;
+  std::atomic<uint64_t> _memory_used_Bytes{0};
+  std::atomic<uint64_t> _memory_peak_Bytes{0};
+  /// built (or currently building) programs by build options + source
+  std::unordered_map<std::string, std::shared_future<cl::Program>> _programs;
+  std::mutex _programs_mutex;
+
+  inline static const std::string _device_capabilities{
+      "#define def_workgroup_size 64\n"
+      "#ifdef cl_khr_fp64\n"
+      "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+      "#endif\n"
+      "#ifdef cl_khr_fp16\n"
+      "#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n"
+      "#endif\n"
+      "#ifdef cl_khr_int64_base_atomics\n"
+      "#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable\n"
+      "#endif\n"
+      // true global range of kernels with a padded global range, see Kernel::set_range(...)
+      "#define MCL_RANGE_PARAMETERS const ulong mcl_global_size_0, const ulong mcl_global_size_1, "
+      "const ulong mcl_global_size_2\n"
+      "#define mcl_global_size(dim) ((dim) == 0 ? mcl_global_size_0 : (dim) == 1 ? mcl_global_size_1 : "
+      "mcl_global_size_2)\n"
+      "#define MCL_RANGE_GUARD if (get_global_id(0) >= mcl_global_size_0 || get_global_id(1) >= mcl_global_size_1 || "
+      "get_global_id(2) >= mcl_global_size_2) return\n"
+      // work item queue of persistent kernels, see LaunchBatch::add_persistent(...)
+      "#define MCL_WORK_QUEUE_PARAMETERS volatile __global uint* mcl_work_counter, const uint mcl_work_count\n"
+      "#define MCL_FOR_EACH_WORK_ITEM(item) for (uint item = atomic_inc(mcl_work_counter); item < mcl_work_count; "
+      "item = atomic_inc(mcl_work_counter))\n\n"};
 };
 
 }  // namespace mcl
\ No newline at end of file
@@ -20,29 +20,133 @@
 #include <CL/opencl.hpp>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace mcl {
 class Environment;
+class MemoryObject;
 template <unsigned dimension, typename T>
 class Memory;
 
 class Kernel {
   friend class Environment;
+  friend class MultiDeviceExecutor;
+  friend class LaunchBatch;
+  template <typename... Args>
+  friend class TypedKernel;
 
  public:
+  /**
+   * @brief Sets the global range (dimensions of size 0 are omitted) and the default local range (see
+   *        set_range(cl::NDRange)).
+   */
   void set_range(cl::size_type x, cl::size_type y = 0, cl::size_type z = 0);
-  void set_range(cl::NDRange global, cl::NDRange local = cl::NDRange(64));
-
+  /**
+   * @brief Sets the global range and the default local range: the local range stored in the TuningDatabase for this
+   *        kernel, device and global range by autotune() if there is one, else WORKGROUP_SIZE work items with the
+   *        dimensions of the global range (64, 8x8 or 4x4x4) if they divide it (or the kernel declares
+   *        MCL_RANGE_PARAMETERS), else cl::NullRange (driver choice).
+   */
+  void set_range(cl::NDRange global);
+  /**
+   * @brief Sets global and local range.
+   *
+   *        If the kernel declares MCL_RANGE_PARAMETERS, the global range does not need to be a multiple of the local
+   *        range: it is rounded up to the next multiple when the kernel is enqueued and the true global range is passed
+   *        to the kernel, which discards the padding work items with MCL_RANGE_GUARD:
+   *
+   *          __kernel void f(__global float* a, MCL_RANGE_PARAMETERS) {
+   *            MCL_RANGE_GUARD;
+   *            ...
+   *          }
+   *
+   *        MCL_RANGE_PARAMETERS must be the last parameter and is set by the Kernel, so it is not part of
+   *        set_parameters(...) and set_args(...). Within the kernel, mcl_global_size(dim) returns the true global size.
+   */
+  void set_range(cl::NDRange global, cl::NDRange local);
+
+  [[nodiscard]] const cl::NDRange& get_global_range() const;
+  [[nodiscard]] const cl::NDRange& get_local_range() const;
+  /**
+   * @brief Returns the global range the kernel is enqueued with: the global range rounded up to a multiple of the
+   *        local range if the kernel declares MCL_RANGE_PARAMETERS, else the global range.
+   */
+  [[nodiscard]] const cl::NDRange& get_enqueued_global_range() const;
+
+  /**
+   * @brief Returns true if the kernel declares MCL_RANGE_PARAMETERS (see Kernel::set_range(...)).
+   */
+  [[nodiscard]] bool has_range_parameters() const;
+
+  /**
+   * @brief Set the arguments in order, continuing after the last argument set by the previous call. After the last
+   *        argument of the kernel (see argument_count()), the next call starts at index 0 again, so a complete set of
+   *        arguments can be passed on every iteration. Throws std::out_of_range (before setting any argument) if a
+   *        call passes more arguments than are left. See TypedKernel for arguments checked at compile time.
+   */
   template <typename... T>
   void set_parameters(const T&... parameters) {
+    _begin_arguments(sizeof...(T));
     link_parameters(parameters...);
   }
 
   template <typename... T>
   void set_args(const T&... args) {
+    _begin_arguments(sizeof...(T));
     link_args(args...);
   }
 
+  /**
+   * @brief Sets the argument with index index. Unlike set_parameters(...) and set_args(...), which set the arguments
+   *        in order, all other arguments are left unchanged.
+   */
+  template <typename T>
+  void set_arg(cl_uint index, const T& arg) {
+    _bind_memory(index, nullptr);
+    int error = _cl_kernel.setArg(index, arg);
+    check_opencl_error(error);
+  }
+
+  /**
+   * @brief Returns the number of arguments of the kernel without MCL_RANGE_PARAMETERS.
+   */
+  [[nodiscard]] cl_uint argument_count() const;
+
+  /**
+   * @brief Selects the command queue of the Environment (see Environment::queue_count()) the kernel is enqueued to.
+   */
+  void set_queue(unsigned queue_index);
+  [[nodiscard]] unsigned get_queue() const;
+
+  /**
+   * @brief Chooses the fastest local range for the current global range by benchmarking candidates on the device.
+   *
+   *        Candidates respect CL_KERNEL_WORK_GROUP_SIZE, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE and
+   *        CL_DEVICE_MAX_WORK_ITEM_SIZES and must divide the global range unless the kernel declares
+   *        MCL_RANGE_PARAMETERS (see Kernel::set_range(...)). The driver choice (cl::NullRange) is
+   *        always a candidate. The choice is stored in the TuningDatabase and reused without measuring by later calls
+   *        (also in later processes if the database is persisted) unless force is true.
+   *
+   *        All arguments must be set, because every candidate is run (repetitions + 1) times on them. Buffers the
+   *        kernel writes are overwritten by these runs, and a kernel updating its data in place (e.g. a[i] += b[i])
+   *        applies the update many times: tune on scratch Memory, or restore the data afterwards.
+   *
+   * @return the chosen local range, which is also set as local range of this kernel
+   */
+  cl::NDRange autotune(unsigned repetitions = 5, bool force = false);
+
+  /**
+   * @brief Sets the floating point operations and Bytes accessed per run. Only used to compute GFLOP/s and GB/s in
+   *        Profiler::statistics().
+   */
+  void set_work_per_run(uint64_t flops, uint64_t bytes = 0);
+
+  [[nodiscard]] const std::string& get_name() const;
+
+  /**
+   * @brief Enqueues t runs of the kernel. The first run waits for event_waitlist, event_returned is the event of the
+   *        last run. The runs are executed one after another, also on out-of-order queues.
+   */
   void enqueue_run(unsigned t = 1, const std::vector<cl::Event>* event_waitlist = nullptr,
                    cl::Event* returned_event = nullptr);
 
@@ -51,7 +155,25 @@ class Kernel {
   void finish_queue();
 
  private:
-  Kernel(Environment& environment, cl::NDRange range, std::string name, const std::string& cl_c_source = "");
+  Kernel(Environment& environment, cl::NDRange range, std::string name, const cl::Program& cl_program,
+         const std::string& cl_c_source);
+
+  /// computes _cl_enqueued_global_range and sets the MCL_RANGE_PARAMETERS arguments
+  void _update_ranges();
+
+  /// key of the kernel with the current global range in the TuningDatabase
+  [[nodiscard]] std::string _tuning_key() const;
+  /// local range used by set_range(cl::NDRange) for the current global range
+  [[nodiscard]] cl::NDRange _default_local_range() const;
+
+  /// remembers the Memory bound to argument index (nullptr: no Memory)
+  void _bind_memory(cl_uint index, MemoryObject* memory);
+
+  /// starts a set_parameters(...) or set_args(...) call setting count arguments: wraps to index 0 after the last
+  /// argument was set, throws std::out_of_range if fewer than count arguments are left
+  void _begin_arguments(size_t count);
+  /// index of the next argument set by set_parameters(...) and set_args(...)
+  cl_uint _next_argument();
 
   template <typename T0, typename... Tn>
   void link_args(const T0& arg, const Tn&... args) {
@@ -61,7 +183,9 @@ class Kernel {
 
   template <typename T>
   void link_arg(const T& arg) {
-    int error = _cl_kernel.setArg(_parameter_count++, arg);
+    const cl_uint index = _next_argument();
+    _bind_memory(index, nullptr);
+    int error = _cl_kernel.setArg(index, arg);
     check_opencl_error(error);
   }
 
@@ -69,13 +193,19 @@ class Kernel {
 
   template <unsigned dimension, typename T>
   void link_parameter(const Memory<dimension, T>& memory) {
-    int error = _cl_kernel.setArg(_parameter_count++, memory.get_cl_buffer());
+    // a kernel may write every bound buffer, so coherent Memory is synchronized by the launches. Whether the Memory
+    // is coherent is checked on every launch: set_coherent(...) may be called after binding it
+    const cl_uint index = _next_argument();
+    _bind_memory(index, const_cast<Memory<dimension, T>*>(&memory));
+    int error = _cl_kernel.setArg(index, memory.get_cl_buffer());
     check_opencl_error(error);
   }
 
   template <typename T>
   void link_parameter(const T& parameter) {
-    int error = _cl_kernel.setArg(_parameter_count++, sizeof(T), static_cast<void*>(parameter));
+    const cl_uint index = _next_argument();
+    _bind_memory(index, nullptr);
+    int error = _cl_kernel.setArg(index, parameter);
     check_opencl_error(error);
   }
 
@@ -88,23 +218,24 @@ class Kernel {
   }
 
   std::string _name;
+  /// fnv1a_64 of the program source, identifies the kernel in the TuningDatabase
+  uint64_t _program_hash;
   cl::Kernel _cl_kernel;
   Environment* _environment;
   cl::NDRange _cl_global_range;
   cl::NDRange _cl_local_range;
+  cl::NDRange _cl_enqueued_global_range;
+  /// set if the kernel declares MCL_RANGE_PARAMETERS, which are its last three arguments
+  bool _range_parameters{false};
   cl_uint _parameter_count{0};
-
-  const std::string _device_capabilities{
-      "#define def_workgroup_size 64\n"
-      "#ifdef cl_khr_fp64\n"
-      "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
-      "#endif\n"
-      "#ifdef cl_khr_fp16\n"
-      "#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n"
-      "#endif\n"
-      "#ifdef cl_khr_int64_base_atomics\n"
-      "#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable\n"
-      "#endif\n\n"};
+  /// set by constructor: CL_KERNEL_NUM_ARGS without MCL_RANGE_PARAMETERS
+  cl_uint _argument_count{0};
+  /// Memory bound per argument index, coherent Memory is synchronized by the launches (see
+  /// MemoryBase::set_coherent(...))
+  std::vector<MemoryObject*> _bound_memory;
+  unsigned _queue_index{0};
+  uint64_t _flops_per_run{0};
+  uint64_t _bytes_per_run{0};
 };
 
 }  // namespace mcl
\ No newline at end of file
@@ -0,0 +1,125 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+#endif
+#define CL_HPP_ENABLE_EXCEPTIONS
+#include <CL/opencl.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace mcl {
+class Environment;
+class Kernel;
+
+// ===== LaunchBatch ===================================================================================================
+/**
+ * @brief Enqueues many launches of small kernels with as little host overhead as possible.
+ *
+ *        Ranges and queues of the added kernels are validated and copied when they are added. enqueue() then issues
+ *        all launches with plain clEnqueueNDRangeKernel calls, checks the errors once and flushes every used queue
+ *        once. Events are only created if the Environment profiles (every launch is recorded) or if coherent Memory is
+ *        bound to a kernel. Later changes of the range or the queue of a Kernel are not seen by the batch, add the
+ *        kernel again after clear(). Kernel arguments are not copied: the launches use the arguments set at enqueue().
+ *
+ *        For many tiny work items, a persistent kernel (see add_persistent(...)) processes all items in a single
+ *        launch instead.
+ *
+ *        On out-of-order queues (Environment::Options::out_of_order), every launch waits for the previous launch on
+ *        its queue, so the launches run in the order they were added like on in-order queues. This needs an event per
+ *        launch.
+ */
+class LaunchBatch {
+ public:
+  explicit LaunchBatch(Environment& environment);
+  ~LaunchBatch();
+
+  LaunchBatch(const LaunchBatch&) = delete;
+  LaunchBatch& operator=(const LaunchBatch&) = delete;
+
+  /**
+   * @brief Appends count launches of kernel. Throws std::runtime_error if kernel belongs to another Environment or if
+   *        its local range does not fit its global range or the device limits.
+   */
+  void add(Kernel& kernel, unsigned count = 1);
+
+  /**
+   * @brief Appends one launch of a persistent kernel that processes work_items items.
+   *
+   *        The kernel declares MCL_WORK_QUEUE_PARAMETERS as parameters argument_index and argument_index + 1 and loops
+   *        over the items with MCL_FOR_EACH_WORK_ITEM, which hands out the item indices through an atomic counter:
+   *
+   *          __kernel void f(__global float* a, MCL_WORK_QUEUE_PARAMETERS) {
+   *            MCL_FOR_EACH_WORK_ITEM(item) {
+   *              a[item] += 1.0f;
+   *            }
+   *          }
+   *
+   *        The global range should just fill the device (e.g. compute units * local range * 4): every work item
+   *        processes items until all are taken. The counter is reset and both arguments are set on every enqueue().
+   */
+  void add_persistent(Kernel& kernel, cl_uint argument_index, uint32_t work_items);
+
+  /**
+   * @brief Enqueues all launches in the order they were added and flushes the used queues. The first launch on every
+   *        queue waits for event_waitlist, event_returned is the event of the last launch.
+   */
+  void enqueue(const std::vector<cl::Event>* event_waitlist = nullptr, cl::Event* event_returned = nullptr);
+
+  /**
+   * @brief enqueue() and waits until all launches are finished.
+   */
+  void run(const std::vector<cl::Event>* event_waitlist = nullptr);
+
+  /**
+   * @brief Returns the number of launches per enqueue().
+   */
+  [[nodiscard]] size_t size() const;
+
+  void clear();
+
+ private:
+  struct Launch {
+    Kernel* kernel;
+    cl_kernel kernel_handle;
+    unsigned queue_index;
+    cl_command_queue queue_handle;
+    cl_uint dimensions;
+    std::array<size_t, 3> global;
+    std::array<size_t, 3> local;
+    /// false for a NullRange local range (driver choice)
+    bool has_local;
+    unsigned count;
+    /// persistent launches: index of MCL_WORK_QUEUE_PARAMETERS, items and work item counter (count is 1)
+    bool persistent{false};
+    cl_uint argument_index{0};
+    uint32_t work_items{0};
+    cl::Buffer counter{};
+  };
+
+  Launch _prepare(Kernel& kernel, unsigned count);
+  void _release_counters();
+
+  Environment* _environment;
+  std::vector<Launch> _launches;
+  /// queues used by the launches, flushed once per enqueue()
+  std::vector<cl_command_queue> _queues;
+  std::vector<cl::Event> _waitlist;
+  std::vector<cl::Event> _launch_waitlist;
+  /// out-of-order queues: event of the last command enqueued to each queue of _queues
+  std::vector<cl::Event> _queue_events;
+};
+
+}  // namespace mcl
@@ -0,0 +1,73 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace mcl {
+
+// ===== MappedFile ====================================================================================================
+/**
+ * @brief A file mapped into memory with mmap. Used as host data of mcl::Memory without reading the file.
+ *
+ *        Only available on POSIX systems: the constructor throws std::runtime_error elsewhere.
+ */
+class MappedFile {
+ public:
+  enum class Mode {
+    /// the file is mapped copy-on-write: the mapping can be written to, but changes are not written to the file
+    READ_ONLY,
+    /// changes of the mapping are written to the file (see sync())
+    READ_WRITE
+  };
+
+  /**
+   * @brief Maps file. With Mode::READ_WRITE and size_Bytes > 0, the file is created if it does not exist and resized
+   *        to size_Bytes.
+   *
+   *        Throws std::runtime_error if the file can not be opened or mapped.
+   */
+  explicit MappedFile(const std::filesystem::path& file, Mode mode = Mode::READ_ONLY, size_t size_Bytes = 0);
+  ~MappedFile();
+
+  /// Copy Constructor
+  MappedFile(const MappedFile& mapped_file) = delete;
+  /// Copy Assignment Operator
+  MappedFile& operator=(const MappedFile& mapped_file) = delete;
+
+  /// Move Constructor
+  MappedFile(MappedFile&& mapped_file) noexcept;
+  /// Move Assignment Operator
+  MappedFile& operator=(MappedFile&& mapped_file) noexcept;
+
+  void* data() { return _data; }
+  [[nodiscard]] const void* data() const { return _data; }
+  [[nodiscard]] size_t size() const { return _size; }
+  [[nodiscard]] Mode mode() const { return _mode; }
+  [[nodiscard]] const std::filesystem::path& path() const { return _path; }
+
+  /**
+   * @brief Blocks until all changes of a Mode::READ_WRITE mapping are written to the file (msync).
+   */
+  void sync();
+
+ private:
+  void _unmap();
+
+  void* _data{nullptr};
+  size_t _size{0};
+  Mode _mode;
+  std::filesystem::path _path;
+};
+
+}  // namespace mcl
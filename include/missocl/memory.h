@@ -11,12 +11,21 @@
 
 #pragma once
 
+#include <missocl/device.h>
 #include <missocl/environment.h>
+#include <missocl/mapped_file.h>
 #include <missocl/utils.h>
 
+#include <algorithm>
+#include <array>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <vector>
 
@@ -25,200 +34,839 @@ namespace mcl {
 template <unsigned dimensions, typename T>
 class Memory {};
 
-template <typename T>
-class Memory<1, T> {
+/**
+ * @brief Defines where the host data of a mcl::Memory lives and how it is transferred to and from the device.
+ */
+enum class MemoryPolicy {
+  /// host data is allocated with new T[] (or provided by the user), transfers copy from/to pageable memory
+  PAGEABLE,
+  /// host data lives in a mapped CL_MEM_ALLOC_HOST_PTR buffer, transfers to the device buffer are DMA transfers from
+  /// pinned memory. Wrapped user data can not be pinned and is treated as PAGEABLE.
+  PINNED,
+  /// host and device share one buffer (CL_MEM_ALLOC_HOST_PTR, or CL_MEM_USE_HOST_PTR for wrapped user data). Transfers
+  /// are replaced by map/unmap: write_to_device() unmaps the buffer for kernels, read_from_device() maps it for host
+  /// access. On CPUs and integrated GPUs no data is copied at all. Wrapped user data that is not aligned to
+  /// Device::memory_alignment_Bytes() is treated as PAGEABLE. On CPU devices, owned data is initialized by the device,
+  /// so that it is placed on the NUMA node(s) of the device (first touch, see Device::partition_by_numa()).
+  ZERO_COPY,
+  /// no host data: for buffers the host never accesses. Wrapped user data is copied to the device on construction.
+  /// Transfers throw std::runtime_error, data() returns nullptr.
+  DEVICE_ONLY,
+  /// pinned host data only (a mapped CL_MEM_ALLOC_HOST_PTR buffer) that is not counted as device memory: for staging
+  /// buffers. Like ZERO_COPY, but always coherent (see MemoryBase::set_coherent(...)): kernels it is bound to access
+  /// the host memory directly.
+  HOST_ONLY
+};
+
+// ===== MemoryObject ==================================================================================================
+/**
+ * @brief Type independent interface of mcl::Memory. Used by Kernel to synchronize coherent Memory (see
+ *        MemoryBase::set_coherent(...)) around kernel launches.
+ */
+class MemoryObject {
+  friend class Kernel;
+  friend class LaunchBatch;
+
  public:
-  struct Range {
-    explicit Range(size_t x_size_) : x_size(x_size_) {}
-    size_t x_size;
-    size_t y_size{0};
-    size_t z_size{0};
-  };
+  virtual ~MemoryObject() = default;
 
-  Memory(Environment* environment, T* data, size_t size)
-      : _environment(environment), _data(data), _range(size), _unowned_data(true) {
-    _allocate_device_buffer();
-  }
+  [[nodiscard]] virtual bool coherent() const = 0;
 
-  Memory(Environment* environment, size_t x_size, T default_value = static_cast<T>(0))
-      : _environment(environment), _range(x_size) {
-    _data = new T[size()];
-    std::fill_n(_data, size(), default_value);
-    _allocate_device_buffer();
-  }
+ protected:
+  /// enqueues the transfer of all host side changes and appends the events a kernel must wait for to events
+  virtual void _acquire_for_device(std::vector<cl::Event>& events) = 0;
+  /// marks the device data as modified by the kernel that signals event
+  virtual void _release_from_device(const cl::Event& event) = 0;
+};
 
-  ~Memory() {
-    if (!_unowned_data) {
-      delete[] _data;
+// ===== MemoryBase ====================================================================================================
+/**
+ * @brief Dimension independent part of mcl::Memory: manages the host data, the device buffer and the transfers
+ *        between them.
+ */
+template <typename T>
+class MemoryBase : public MemoryObject {
+ public:
+  /// Copy Constructor
+  MemoryBase(const MemoryBase& memory) = delete;
+  /// Copy Assignment Operator
+  MemoryBase& operator=(const MemoryBase& memory) = delete;
+
+  /**
+   * @brief Returns the host data.
+   *
+   *        For MemoryPolicy::ZERO_COPY, host data must only be accessed while the buffer is mapped (see mapped()). For
+   *        MemoryPolicy::DEVICE_ONLY, nullptr is returned. In coherent mode, the non const version synchronizes the
+   *        host data and marks all of it as modified.
+   */
+  T* data() {
+    if (coherent()) {
+      _host_access(0, _size);
     }
+    return _data;
   }
-
-  T* data() { return _data; }
   const T* data() const { return _data; }
-  [[nodiscard]] size_t size() const { return _range.x_size; }
-  [[nodiscard]] constexpr unsigned dimension() const { return 1; };
+  [[nodiscard]] size_t size() const { return _size; }
   [[nodiscard]] size_t mem_size() const { return size() * sizeof(T); }
-  T& operator[](size_t i) { return _data[i]; }
-  const T& operator[](size_t i) const { return _data[i]; }
-  T& at(size_t x) { return _data[x]; }
-  const T& at(size_t x) const { return _data[x]; }
-  void assign(T* data, size_t size) {
-    if (!_unowned_data) {
-      delete[] _data;
+  /**
+   * @brief Returns element i. In coherent mode, the non const version synchronizes the host data (mapping shared
+   *        buffers again) and marks element i as modified. Throws std::runtime_error for MemoryPolicy::DEVICE_ONLY
+   *        Memory, which has no host data, and for an unmapped MemoryPolicy::ZERO_COPY or HOST_ONLY Memory that is not
+   *        coherent (see mapped()).
+   */
+  T& operator[](size_t i) {
+    _check_host_data();
+    if (coherent()) {
+      _host_access(i, i + 1);
     }
-    _unowned_data = true;
-    _data = data;
-    _range.x_size = size;
-    _allocate_device_buffer();
+    _check_mapped();
+    return _data[i];
+  }
+  const T& operator[](size_t i) const {
+    _check_host_data();
+    _check_mapped();
+    return _data[i];
   }
 
   [[nodiscard]] const cl::Buffer& get_cl_buffer() const { return _device_buffer; }
 
-  void reset(T default_value = static_cast<T>(0)) {
-    std::fill_n(_data, size(), default_value);
-    write_to_device();
+  [[nodiscard]] MemoryPolicy get_policy() const { return _policy; }
+
+  /**
+   * @brief Enables or disables coherent mode.
+   *
+   *        In coherent mode, write_to_device() and read_from_device() do not need to be called: writes through
+   *        operator[], at() and data() mark host ranges as modified, and every Kernel launch this Memory is bound to
+   *        (Kernel::set_parameters(...)) first transfers the modified host range to the device and then marks the
+   *        device data as modified. The next non const host access reads the device data back. Const accessors do not
+   *        synchronize.
+   *
+   *        The host data is considered up to date when coherent mode is enabled. Disabling it synchronizes both sides.
+   *        Coherent mode may be enabled before or after the Memory is bound to a kernel. A Memory must outlive all
+   *        launches of the kernels it is bound to.
+   */
+  void set_coherent(bool coherent) {
+    if (_policy == MemoryPolicy::DEVICE_ONLY) {
+      throw std::runtime_error("Memory " + get_name() + " has no host data: coherent mode is not supported.");
+    }
+    if (coherent && !_coherent) {
+      _host_dirty_begin = 0;
+      _host_dirty_end = _size;
+      _device_dirty = false;
+    } else if (!coherent && _coherent) {
+      _host_access(0, 0);
+      if (!_shared_buffer() && _host_dirty_begin < _host_dirty_end) {
+        _transfer_region(Profiler::Command::WRITE, {_size, 1, 1}, {_host_dirty_begin, 0, 0},
+                         {_host_dirty_end - _host_dirty_begin, 1, 1}, true, nullptr, nullptr);
+      }
+      _host_dirty_begin = _host_dirty_end = 0;
+    }
+    _coherent = coherent;
+  }
+  [[nodiscard]] bool coherent() const override { return _coherent || _policy == MemoryPolicy::HOST_ONLY; }
+
+  /**
+   * @brief Selects the command queue of the Environment (see Environment::queue_count()) used for all transfers of
+   *        this Memory.
+   */
+  void set_queue(unsigned queue_index) { _queue_index = _environment->_checked_queue_index(queue_index); }
+  [[nodiscard]] unsigned get_queue() const { return _queue_index; }
+
+  /**
+   * @brief Sets the name this Memory is recorded with by the Profiler of the Environment.
+   */
+  void set_name(std::string name) { _name = std::move(name); }
+  [[nodiscard]] std::string get_name() const {
+    if (!_name.empty()) {
+      return _name;
+    }
+    std::stringstream ss;
+    ss << "memory@" << static_cast<const void*>(this);
+    return ss.str();
   }
 
+  /**
+   * @brief Sets all elements to default_value.
+   *
+   *        The device buffer is filled on the device (enqueueFillBuffer), so no data is transferred. The host data is
+   *        only filled if fill_host is true; otherwise it is left unchanged (in coherent mode, it is read back on the
+   *        next host access). Blocks until the device fill finished.
+   *
+   *        MemoryPolicy::ZERO_COPY and HOST_ONLY Memory and element types whose size is not a power of two (up to 128
+   *        Bytes) are filled on the host and written to the device.
+   */
+  void reset(T default_value = static_cast<T>(0), bool fill_host = true) {
+    if (_policy == MemoryPolicy::DEVICE_ONLY && !_device_fillable()) {
+      std::vector<T> host_data(_size, default_value);
+      check_opencl_error(_queue().enqueueWriteBuffer(_device_buffer, true, 0, mem_size(), host_data.data()));
+      return;
+    }
+    fill_host = fill_host && _policy != MemoryPolicy::DEVICE_ONLY;
+    if (coherent()) {
+      // all data is overwritten: pending changes of both sides are discarded
+      _host_dirty_begin = _host_dirty_end = 0;
+      _device_dirty = false;
+      _device_event = cl::Event();
+    }
+    if (_shared_buffer() || !_device_fillable()) {
+      if (_shared_buffer() && !_mapped) {
+        map();
+      }
+      std::fill_n(_data, size(), default_value);
+      if (!coherent()) {
+        write_to_device();
+      } else if (!_shared_buffer()) {
+        _host_dirty_begin = 0;
+        _host_dirty_end = _size;
+      }
+      return;
+    }
+    cl::Event event;
+    // coherent: marks the device data as modified
+    fill_device(default_value, nullptr, &event);
+    if (fill_host) {
+      std::fill_n(_data, size(), default_value);
+      // both sides hold the same data, nothing has to be read back
+      _device_dirty = false;
+      _device_event = cl::Event();
+    }
+    check_opencl_error(event.wait());
+  }
+
+  /**
+   * @brief Enqueues filling the device buffer with value (enqueueFillBuffer). The host data is not changed; in
+   *        coherent mode, pending host changes are discarded and the next host access reads the filled data back.
+   *
+   *        Throws std::runtime_error for MemoryPolicy::ZERO_COPY and HOST_ONLY Memory and for element types whose size
+   *        is not a power of two up to 128 Bytes.
+   */
+  void fill_device(T value, const std::vector<cl::Event>* event_waitlist = nullptr,
+                   cl::Event* event_returned = nullptr) {
+    if (_shared_buffer() || !_device_fillable()) {
+      throw std::runtime_error("Memory " + get_name() + " can not be filled on the device.");
+    }
+    cl::Event event;
+    cl::Event* fill_event = coherent() && event_returned == nullptr ? &event : _event(event_returned, event);
+    cl_int error = _queue().enqueueFillBuffer(_device_buffer, value, 0, mem_size(), event_waitlist, fill_event);
+    check_opencl_error(error);
+    _record(Profiler::Command::FILL, event_returned, event, mem_size());
+    if (coherent()) {
+      // the fill overwrites all data, including host changes that were not transferred yet
+      _host_dirty_begin = _host_dirty_end = 0;
+      _release_from_device(*fill_event);
+    }
+  }
+
+  /**
+   * @brief Copies the host data to the device (MemoryPolicy::ZERO_COPY: unmaps the buffer if it is mapped).
+   */
   void write_to_device(bool blocking = true, const std::vector<cl::Event>* event_waitlist = nullptr,
                        cl::Event* event_returned = nullptr) {
-    cl_int error = _environment->_cl_queue.enqueueWriteBuffer(_device_buffer, blocking, 0, mem_size(), _data, event_waitlist,
-                                               event_returned);
+    _check_host_data();
+    _host_dirty_begin = _host_dirty_end = 0;
+    if (_shared_buffer()) {
+      if (_mapped) {
+        unmap(event_waitlist, event_returned);
+        if (blocking) {
+          check_opencl_error(_queue().finish());
+        }
+      } else {
+        _enqueue_marker(blocking, event_waitlist, event_returned);
+      }
+      return;
+    }
+    cl::Event event;
+    cl_int error = _queue().enqueueWriteBuffer(_device_buffer, blocking, 0, mem_size(), _data, event_waitlist,
+                                               _event(event_returned, event));
     check_opencl_error(error);
+    _record(Profiler::Command::WRITE, event_returned, event, mem_size());
   }
 
+  /**
+   * @brief Copies the device data to the host (MemoryPolicy::ZERO_COPY: maps the buffer if it is not mapped).
+   */
   void read_from_device(bool blocking = true, const std::vector<cl::Event>* event_waitlist = nullptr,
                         cl::Event* event_returned = nullptr) {
-    cl_int error = _environment->_cl_queue.enqueueReadBuffer(_device_buffer, blocking, 0, mem_size(), static_cast<void*>(_data),
-                                              event_waitlist, event_returned);
+    _check_host_data();
+    _device_dirty = false;
+    if (_shared_buffer()) {
+      map(CL_MAP_READ | CL_MAP_WRITE, blocking, event_waitlist, event_returned);
+      return;
+    }
+    cl::Event event;
+    cl_int error = _queue().enqueueReadBuffer(_device_buffer, blocking, 0, mem_size(), static_cast<void*>(_data),
+                                              event_waitlist, _event(event_returned, event));
     check_opencl_error(error);
+    _record(Profiler::Command::READ, event_returned, event, mem_size());
   }
 
- private:
-  void _allocate_device_buffer() {
-    _environment->_device->_memory_used_Bytes += mem_size();
-    int error = 0;
-    if (_environment->_device->intel_gt_4gb_buffer_required()) {
-      // https://github.com/intel/compute-runtime/blob/master/programmers-guide/ALLOCATIONS_GREATER_THAN_4GB.md
-      _device_buffer =
-          cl::Buffer(_environment->_cl_context, CL_MEM_READ_WRITE | ((int)1 << 23), mem_size(), nullptr, &error);
+  /**
+   * @brief Maps the buffer of a MemoryPolicy::ZERO_COPY or HOST_ONLY Memory for host access. data() points to the
+   *        mapped data afterwards. For other policies and if the buffer is already mapped, only a marker waiting for
+   *        event_waitlist is enqueued (event_returned is always valid).
+   */
+  void map(cl_map_flags flags = CL_MAP_READ | CL_MAP_WRITE, bool blocking = true,
+           const std::vector<cl::Event>* event_waitlist = nullptr, cl::Event* event_returned = nullptr) {
+    if (!_shared_buffer() || _mapped) {
+      _enqueue_marker(blocking, event_waitlist, event_returned);
+      return;
+    }
+    cl_int error = CL_SUCCESS;
+    void* mapped = _queue().enqueueMapBuffer(_device_buffer, blocking, flags, 0, mem_size(), event_waitlist,
+                                             event_returned, &error);
+    check_opencl_error(error);
+    _data = static_cast<T*>(mapped);
+    _mapped = true;
+  }
+
+  /**
+   * @brief Unmaps the buffer of a MemoryPolicy::ZERO_COPY or HOST_ONLY Memory, so that it can be used by kernels.
+   *        For other policies and if the buffer is not mapped, only a marker waiting for event_waitlist is enqueued.
+   */
+  void unmap(const std::vector<cl::Event>* event_waitlist = nullptr, cl::Event* event_returned = nullptr) {
+    if (!_shared_buffer() || !_mapped) {
+      _enqueue_marker(false, event_waitlist, event_returned);
+      return;
+    }
+    check_opencl_error(_queue().enqueueUnmapMemObject(_device_buffer, _data, event_waitlist, event_returned));
+    _mapped = false;
+    if (!_unowned_data) {
+      // memory allocated by OpenCL must not be accessed while it is unmapped
+      _data = nullptr;
+    }
+  }
+
+  /**
+   * @brief Returns true if the host data can be accessed: always true except for an unmapped
+   *        MemoryPolicy::ZERO_COPY or HOST_ONLY Memory (and for MemoryPolicy::DEVICE_ONLY Memory, which has no host
+   *        data).
+   */
+  [[nodiscard]] bool mapped() const {
+    return _policy != MemoryPolicy::DEVICE_ONLY && (!_shared_buffer() || _mapped);
+  }
+
+  /**
+   * @brief Enqueues copying the device data to the device buffer of destination (enqueueCopyBuffer on the queue of
+   *        destination), without a round trip through the host.
+   *
+   *        Both Memory objects must have the same size and their Environments must share a context (see
+   *        Environment::create_shared(...)), std::runtime_error otherwise. Like for a kernel run, shared buffers
+   *        (MemoryPolicy::ZERO_COPY, HOST_ONLY) are unmapped and coherent host changes of this Memory are written
+   *        first. Pending host changes of destination are discarded, its host data is updated by read_from_device()
+   *        (or automatically in coherent mode).
+   */
+  void copy_to(MemoryBase& destination, const std::vector<cl::Event>* event_waitlist = nullptr,
+               cl::Event* event_returned = nullptr) {
+    _check_shared_context(*destination._environment);
+    if (destination.mem_size() != mem_size()) {
+      throw std::runtime_error("Memory " + get_name() + " (" + std::to_string(mem_size()) +
+                               " Bytes) can not be copied to Memory " + destination.get_name() + " (" +
+                               std::to_string(destination.mem_size()) + " Bytes).");
+    }
+    std::vector<cl::Event> waitlist;
+    if (event_waitlist != nullptr) {
+      waitlist = *event_waitlist;
+    }
+    _acquire_for_device(waitlist);
+    // destination is overwritten completely: its host changes are not written
+    destination._host_dirty_begin = destination._host_dirty_end = 0;
+    destination._acquire_for_device(waitlist);
+    cl::Event event;
+    cl_int error = destination._queue().enqueueCopyBuffer(_device_buffer, destination._device_buffer, 0, 0, mem_size(),
+                                                          &waitlist, _event(event_returned, event));
+    check_opencl_error(error);
+    destination._record(Profiler::Command::COPY, event_returned, event, mem_size());
+    if (destination.coherent()) {
+      destination._release_from_device(event_returned != nullptr ? *event_returned : event);
+    }
+  }
+
+  /**
+   * @brief Enqueues migrating the device buffer to the device of environment (enqueueMigrateMemObjects on its first
+   *        queue), so that its kernels find the data resident. flags may contain CL_MIGRATE_MEM_OBJECT_HOST and
+   *        CL_MIGRATE_MEM_OBJECT_CONTENT_UNDEFINED.
+   *
+   *        The Environments must share a context (see Environment::create_shared(...)), std::runtime_error otherwise.
+   *        The Memory stays owned by its Environment: transfers still use its queue and the buffer is still counted
+   *        as memory of its device.
+   */
+  void migrate(Environment& environment, cl_mem_migration_flags flags = 0,
+               const std::vector<cl::Event>* event_waitlist = nullptr, cl::Event* event_returned = nullptr) {
+    _check_shared_context(environment);
+    std::vector<cl::Event> waitlist;
+    if (event_waitlist != nullptr) {
+      waitlist = *event_waitlist;
+    }
+    _acquire_for_device(waitlist);
+    check_opencl_error(environment.get_cl_queue().enqueueMigrateMemObjects({_device_buffer}, flags, &waitlist,
+                                                                            event_returned));
+  }
+
+ protected:
+  MemoryBase(Environment* environment, T* data, size_t size, MemoryPolicy policy)
+      : _environment(environment), _policy(policy), _size(size) {
+    _init_unowned(data);
+  }
+
+  MemoryBase(Environment* environment, size_t size, T default_value, MemoryPolicy policy)
+      : _environment(environment), _policy(policy), _size(size) {
+    _init_owned();
+    if (_policy == MemoryPolicy::DEVICE_ONLY) {
+      reset(default_value);
+    } else if (_first_touch_on_device()) {
+      _first_touch(default_value);
+    } else {
+      std::fill_n(_data, size, default_value);
+    }
+  }
+
+  ~MemoryBase() override { _release(); }
+
+  void _assign(T* data, size_t size) {
+    _release();
+    _host_data_owner.reset();
+    _size = size;
+    _init_unowned(data);
+    if (coherent()) {
+      _host_dirty_begin = 0;
+      _host_dirty_end = _size;
+      _device_dirty = false;
+      _device_event = cl::Event();
+    }
+  }
+
+  /// coherent mode: reads modified device data back and adds [begin, end) to the modified host range
+  void _host_access(size_t begin, size_t end) {
+    if (_device_dirty || !mapped()) {
+      std::vector<cl::Event> waitlist;
+      if (_device_event() != nullptr) {
+        waitlist.push_back(_device_event);
+      }
+      read_from_device(true, &waitlist);
+      _device_event = cl::Event();
+    }
+    if (begin >= end) {
+      return;
+    }
+    if (_host_dirty_begin == _host_dirty_end) {
+      _host_dirty_begin = begin;
+      _host_dirty_end = end;
+    } else {
+      _host_dirty_begin = std::min(_host_dirty_begin, begin);
+      _host_dirty_end = std::max(_host_dirty_end, end);
+    }
+  }
+
+  void _acquire_for_device(std::vector<cl::Event>& events) override {
+    if (_shared_buffer()) {
+      if (_mapped) {
+        cl::Event event;
+        unmap(nullptr, &event);
+        events.push_back(event);
+      }
+    } else if (_host_dirty_begin < _host_dirty_end) {
+      cl::Event event;
+      _transfer_region(Profiler::Command::WRITE, {_size, 1, 1}, {_host_dirty_begin, 0, 0},
+                       {_host_dirty_end - _host_dirty_begin, 1, 1}, false, nullptr, &event);
+      events.push_back(event);
+    }
+    _host_dirty_begin = _host_dirty_end = 0;
+  }
+
+  void _release_from_device(const cl::Event& event) override {
+    _device_dirty = true;
+    _device_event = event;
+  }
+
+  void _init_owned() {
+    _unowned_data = false;
+    if (_policy == MemoryPolicy::DEVICE_ONLY) {
+      _allocate_device_buffer(0, nullptr);
+      return;
+    }
+    if (_shared_buffer()) {
+      _allocate_device_buffer(CL_MEM_ALLOC_HOST_PTR, nullptr);
+      map();
+      return;
+    }
+    if (_policy == MemoryPolicy::PINNED) {
+      int error = 0;
+      _host_buffer =
+          _environment->_allocate_buffer(mem_size(), CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, nullptr, false);
+      _data = static_cast<T*>(_queue().enqueueMapBuffer(_host_buffer, true, CL_MAP_READ | CL_MAP_WRITE, 0, mem_size(),
+                                                        nullptr, nullptr, &error));
+      check_opencl_error(error);
+    } else {
+      _data = new T[_size];
+    }
+    _allocate_device_buffer(0, nullptr);
+  }
+
+  /**
+   * Owned shared buffers of CPU devices are initialized by the device instead of the host thread. The pages are then
+   * first touched, and therefore placed, on the NUMA node(s) of the device, see Device::partition_by_numa().
+   */
+  [[nodiscard]] bool _first_touch_on_device() const {
+    return _shared_buffer() && _device_fillable() && _environment->get_device()->type() == Device::Type::CPU;
+  }
+
+  void _first_touch(T value) {
+    unmap();
+    cl::Event event;
+    check_opencl_error(_queue().enqueueFillBuffer(_device_buffer, value, 0, mem_size(), nullptr, &event));
+    check_opencl_error(event.wait());
+    map();
+  }
+
+  void _init_unowned(T* data) {
+    _unowned_data = true;
+    if (_policy == MemoryPolicy::DEVICE_ONLY) {
+      _allocate_device_buffer(CL_MEM_COPY_HOST_PTR, data);
+      return;
+    }
+    _data = data;
+    if (_policy == MemoryPolicy::PINNED) {
+      _policy = MemoryPolicy::PAGEABLE;
+    }
+    uint32_t alignment = std::max<uint32_t>(_environment->get_device()->memory_alignment_Bytes(), 1);
+    if (_policy == MemoryPolicy::ZERO_COPY && reinterpret_cast<uintptr_t>(data) % alignment != 0) {
+      // the driver would copy unaligned data anyway: copy explicitly
+      _policy = MemoryPolicy::PAGEABLE;
+    }
+    if (_shared_buffer()) {
+      _allocate_device_buffer(CL_MEM_USE_HOST_PTR, data);
+      map();
+      return;
+    }
+    _allocate_device_buffer(0, nullptr);
+  }
+
+  void _release() {
+    // errors are ignored: _release() is called by the destructor
+    if (_shared_buffer() && _mapped) {
+      try {
+        _queue().enqueueUnmapMemObject(_device_buffer, _data);
+      } catch (const cl::Error&) {
+      }
+      _mapped = false;
+    } else if (_policy == MemoryPolicy::PINNED && !_unowned_data && _data != nullptr) {
+      try {
+        _queue().enqueueUnmapMemObject(_host_buffer, _data);
+      } catch (const cl::Error&) {
+      }
+      _environment->_release_buffer(_host_buffer, mem_size(), CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, nullptr,
+                                    false);
+    } else if (!_unowned_data) {
+      delete[] _data;
+    }
+    _data = nullptr;
+    if (_device_buffer_init) {
+      _environment->_release_buffer(_device_buffer, _buffer_size, _buffer_flags, _buffer_host_ptr,
+                                    _policy != MemoryPolicy::HOST_ONLY);
+      _device_buffer_init = false;
+    }
+  }
+
+  /**
+   * @brief Transfers the box [origin, origin + region) of data with the given extent (all in elements) between host and
+   *        device. Contiguous boxes are transferred with enqueue(Write|Read)Buffer, others with
+   *        enqueue(Write|Read)BufferRect. Host and device data have the same layout.
+   */
+  void _transfer_region(Profiler::Command command, const std::array<size_t, 3>& extent,
+                        const std::array<size_t, 3>& origin, const std::array<size_t, 3>& region, bool blocking,
+                        const std::vector<cl::Event>* event_waitlist, cl::Event* event_returned) {
+    _check_host_data();
+    for (int i = 0; i < 3; ++i) {
+      if (origin[i] > extent[i] || region[i] > extent[i] - origin[i]) {
+        throw std::runtime_error("Memory " + get_name() + ": region exceeds the memory range.");
+      }
+    }
+    if (_shared_buffer()) {
+      // host and device share the buffer: there is nothing to transfer partially
+      if (command == Profiler::Command::WRITE) {
+        write_to_device(blocking, event_waitlist, event_returned);
+      } else {
+        read_from_device(blocking, event_waitlist, event_returned);
+      }
+      return;
+    }
+    size_t count = region[0] * region[1] * region[2];
+    if (count == 0) {
+      return;
+    }
+    cl::Event event;
+    cl_int error;
+    bool contiguous =
+        (region[1] == 1 && region[2] == 1) || (region[0] == extent[0] && (region[2] == 1 || region[1] == extent[1]));
+    if (contiguous) {
+      size_t offset = (origin[2] * extent[1] + origin[1]) * extent[0] + origin[0];
+      if (command == Profiler::Command::WRITE) {
+        error = _queue().enqueueWriteBuffer(_device_buffer, blocking, offset * sizeof(T), count * sizeof(T),
+                                            _data + offset, event_waitlist, _event(event_returned, event));
+      } else {
+        error = _queue().enqueueReadBuffer(_device_buffer, blocking, offset * sizeof(T), count * sizeof(T),
+                                           _data + offset, event_waitlist, _event(event_returned, event));
+      }
     } else {
-      _device_buffer = cl::Buffer(_environment->_cl_context, CL_MEM_READ_WRITE, mem_size(), nullptr, &error);
+      cl::array<cl::size_type, 3> cl_origin{origin[0] * sizeof(T), origin[1], origin[2]};
+      cl::array<cl::size_type, 3> cl_region{region[0] * sizeof(T), region[1], region[2]};
+      size_t row_pitch = extent[0] * sizeof(T);
+      size_t slice_pitch = row_pitch * extent[1];
+      if (command == Profiler::Command::WRITE) {
+        error = _queue().enqueueWriteBufferRect(_device_buffer, blocking, cl_origin, cl_origin, cl_region, row_pitch,
+                                                slice_pitch, row_pitch, slice_pitch, _data, event_waitlist,
+                                                _event(event_returned, event));
+      } else {
+        error = _queue().enqueueReadBufferRect(_device_buffer, blocking, cl_origin, cl_origin, cl_region, row_pitch,
+                                               slice_pitch, row_pitch, slice_pitch, _data, event_waitlist,
+                                               _event(event_returned, event));
+      }
     }
     check_opencl_error(error);
+    _record(command, event_returned, event, count * sizeof(T));
+  }
+
+  /// host and device share _device_buffer, which is mapped for host access
+  [[nodiscard]] bool _shared_buffer() const {
+    return _policy == MemoryPolicy::ZERO_COPY || _policy == MemoryPolicy::HOST_ONLY;
+  }
+
+  void _check_host_data() const {
+    if (_policy == MemoryPolicy::DEVICE_ONLY) {
+      throw std::runtime_error("Memory " + get_name() + " has no host data (MemoryPolicy::DEVICE_ONLY).");
+    }
+  }
+
+  /// host data of shared buffers must not be accessed while they are unmapped (owned data is nullptr then)
+  void _check_mapped() const {
+    if (!mapped()) {
+      throw std::runtime_error("Memory " + get_name() + " is unmapped: call map() or read_from_device() first.");
+    }
+  }
+
+  /// enqueueFillBuffer supports patterns of 1, 2, 4, ..., 128 Bytes
+  static constexpr bool _device_fillable() { return sizeof(T) <= 128 && (sizeof(T) & (sizeof(T) - 1)) == 0; }
+
+  cl::CommandQueue& _queue() { return _environment->_cl_queues[_queue_index]; }
+
+  /// returns the event a command must return: event_returned if set, the local event if profiling, else nullptr
+  cl::Event* _event(cl::Event* event_returned, cl::Event& event) {
+    if (event_returned != nullptr) {
+      return event_returned;
+    }
+    return _environment->profiling() ? &event : nullptr;
+  }
+
+  /// for calls that have nothing to enqueue: event_returned completes once event_waitlist completed
+  void _enqueue_marker(bool blocking, const std::vector<cl::Event>* event_waitlist, cl::Event* event_returned) {
+    const bool waits = event_waitlist != nullptr && !event_waitlist->empty();
+    if (event_returned == nullptr && !waits) {
+      return;
+    }
+    cl::Event event;
+    cl::Event* marker = event_returned != nullptr ? event_returned : &event;
+    check_opencl_error(_queue().enqueueMarkerWithWaitList(event_waitlist, marker));
+    if (blocking && waits) {
+      check_opencl_error(marker->wait());
+    }
+  }
+
+  void _check_shared_context(const Environment& environment) const {
+    if (!_environment->shares_context(environment)) {
+      throw std::runtime_error("Memory " + get_name() +
+                               ": the Environments do not share a context (see Environment::create_shared(...)).");
+    }
+  }
+
+  void _record(Profiler::Command command, const cl::Event* event_returned, const cl::Event& event, size_t bytes) {
+    if (_environment->profiling()) {
+      _environment->_record({.command = command, .name = get_name(), .queue_index = _queue_index, .bytes = bytes},
+                            event_returned != nullptr ? *event_returned : event);
+    }
+  }
+
+  void _allocate_device_buffer(cl_mem_flags host_flags, T* host_ptr) {
+    _buffer_flags = CL_MEM_READ_WRITE | host_flags;
+    _buffer_host_ptr = host_ptr;
+    _buffer_size = mem_size();
+    _device_buffer =
+        _environment->_allocate_buffer(_buffer_size, _buffer_flags, host_ptr, _policy != MemoryPolicy::HOST_ONLY);
     _device_buffer_init = true;
   }
 
   Environment* _environment;
-  T* _data;
+  MemoryPolicy _policy;
+  T* _data{nullptr};
   bool _unowned_data{false};
-  Range _range;
+  size_t _size;
   cl::Buffer _device_buffer;
   bool _device_buffer_init{false};
+  /// arguments _device_buffer was allocated with, needed to release it
+  size_t _buffer_size{0};
+  cl_mem_flags _buffer_flags{0};
+  T* _buffer_host_ptr{nullptr};
+  /// keeps unowned host data alive (e.g. a MappedFile)
+  std::shared_ptr<void> _host_data_owner;
+  /// MemoryPolicy::PINNED: mapped buffer backing _data
+  cl::Buffer _host_buffer;
+  /// MemoryPolicy::ZERO_COPY: true while _device_buffer is mapped for host access
+  bool _mapped{false};
+  unsigned _queue_index{0};
+  std::string _name;
+  /// coherent mode: modified host range [_host_dirty_begin, _host_dirty_end) (elements), device data modified by the
+  /// kernel that signals _device_event
+  bool _coherent{false};
+  size_t _host_dirty_begin{0};
+  size_t _host_dirty_end{0};
+  bool _device_dirty{false};
+  cl::Event _device_event;
 };
 
+// ===== Memory ========================================================================================================
 template <typename T>
-class Memory<2, T> {
+class Memory<1, T> : public MemoryBase<T> {
  public:
   struct Range {
-    explicit Range(size_t x_size_, size_t y_size_) : x_size(x_size_), y_size(y_size_) {}
+    explicit Range(size_t x_size_) : x_size(x_size_) {}
     size_t x_size;
-    size_t y_size;
+    size_t y_size{0};
     size_t z_size{0};
   };
 
-  Memory(Environment* environment, T* data, size_t x_size, size_t y_size)
-      : _environment(environment), _data(data), _range(x_size, y_size), _unowned_data(true) {
-    _allocate_device_buffer();
+  Memory(Environment* environment, T* data, size_t size, MemoryPolicy policy = MemoryPolicy::PAGEABLE)
+      : MemoryBase<T>(environment, data, size, policy), _range(size) {}
+
+  Memory(Environment* environment, size_t x_size, T default_value = static_cast<T>(0),
+         MemoryPolicy policy = MemoryPolicy::PAGEABLE)
+      : MemoryBase<T>(environment, x_size, default_value, policy), _range(x_size) {}
+
+  /**
+   * @brief Uses the mapping of file as host data (file->size() / sizeof(T) elements), so the file is not read before
+   *        it is written to the device. The Memory keeps file alive.
+   *
+   *        With MemoryPolicy::ZERO_COPY, the mapping is used as CL_MEM_USE_HOST_PTR buffer if it is aligned to
+   *        Device::memory_alignment_Bytes() (mappings are page aligned), so CPU devices access the file in place.
+   *        Results are written back to a MappedFile::Mode::READ_WRITE file by read_from_device() and
+   *        MappedFile::sync().
+   *
+   *        Throws std::runtime_error if file is empty or its size is not a multiple of sizeof(T).
+   */
+  Memory(Environment* environment, std::shared_ptr<MappedFile> file, MemoryPolicy policy = MemoryPolicy::PAGEABLE)
+      : MemoryBase<T>(environment, static_cast<T*>(_checked_file(file).data()), _checked_file(file).size() / sizeof(T),
+                      policy),
+        _range(file->size() / sizeof(T)) {
+    this->_host_data_owner = std::move(file);
+  }
+
+  [[nodiscard]] constexpr unsigned dimension() const { return 1; };
+  T& at(size_t x) { return (*this)[x]; }
+  const T& at(size_t x) const { return (*this)[x]; }
+  void assign(T* data, size_t size) {
+    _range.x_size = size;
+    this->_assign(data, size);
   }
 
-  Memory(Environment* environment, size_t x_size, size_t y_size, T default_value = static_cast<T>(0))
-      : _environment(environment), _range(x_size, y_size) {
-    _data = new T[size()];
-    std::fill_n(_data, size(), default_value);
-    _allocate_device_buffer();
+  /**
+   * @brief Copies count elements starting at offset from the host to the device.
+   */
+  void write_range_to_device(size_t offset, size_t count, bool blocking = true,
+                             const std::vector<cl::Event>* event_waitlist = nullptr,
+                             cl::Event* event_returned = nullptr) {
+    this->_transfer_region(Profiler::Command::WRITE, {_range.x_size, 1, 1}, {offset, 0, 0}, {count, 1, 1}, blocking,
+                           event_waitlist, event_returned);
   }
 
-  ~Memory() {
-    if (!_unowned_data) {
-      delete[] _data;
+  /**
+   * @brief Copies count elements starting at offset from the device to the host.
+   */
+  void read_range_from_device(size_t offset, size_t count, bool blocking = true,
+                              const std::vector<cl::Event>* event_waitlist = nullptr,
+                              cl::Event* event_returned = nullptr) {
+    this->_transfer_region(Profiler::Command::READ, {_range.x_size, 1, 1}, {offset, 0, 0}, {count, 1, 1}, blocking,
+                           event_waitlist, event_returned);
+  }
+
+ private:
+  static MappedFile& _checked_file(const std::shared_ptr<MappedFile>& file) {
+    if (file == nullptr) {
+      throw std::runtime_error("Memory: no mapped file.");
+    }
+    if (file->data() == nullptr || file->size() == 0) {
+      throw std::runtime_error("Memory: mapped file '" + file->path().string() + "' is empty.");
     }
+    if (file->size() % sizeof(T) != 0) {
+      throw std::runtime_error("Memory: the size of mapped file '" + file->path().string() + "' (" +
+                               std::to_string(file->size()) + " Bytes) is not a multiple of the element size (" +
+                               std::to_string(sizeof(T)) + " Bytes).");
+    }
+    return *file;
   }
 
-  T* data() { return _data; }
-  const T* data() const { return _data; }
-  [[nodiscard]] size_t size() const { return _range.x_size * _range.y_size; }
+  Range _range;
+};
+
+template <typename T>
+class Memory<2, T> : public MemoryBase<T> {
+ public:
+  struct Range {
+    explicit Range(size_t x_size_, size_t y_size_) : x_size(x_size_), y_size(y_size_) {}
+    size_t x_size;
+    size_t y_size;
+    size_t z_size{0};
+  };
+
+  Memory(Environment* environment, T* data, size_t x_size, size_t y_size, MemoryPolicy policy = MemoryPolicy::PAGEABLE)
+      : MemoryBase<T>(environment, data, x_size * y_size, policy), _range(x_size, y_size) {}
+
+  Memory(Environment* environment, size_t x_size, size_t y_size, T default_value = static_cast<T>(0),
+         MemoryPolicy policy = MemoryPolicy::PAGEABLE)
+      : MemoryBase<T>(environment, x_size * y_size, default_value, policy), _range(x_size, y_size) {}
+
   [[nodiscard]] constexpr unsigned dimension() const { return 2; };
-  [[nodiscard]] size_t mem_size() const { return size() * sizeof(T); }
-  T& operator[](size_t i) { return _data[i]; }
-  const T& operator[](size_t i) const { return _data[i]; }
-  T& at(size_t x, size_t y) { return _data[_range.x_size * y + x]; }
-  const T& at(size_t x, size_t y) const { return at(x, y); }
+  T& at(size_t x, size_t y) { return (*this)[_range.x_size * y + x]; }
+  const T& at(size_t x, size_t y) const { return (*this)[_range.x_size * y + x]; }
   void assign(T* data, size_t x_size, size_t y_size) {
-    if (!_unowned_data) {
-      delete[] _data;
-    }
-    _unowned_data = true;
-    _data = data;
     _range.x_size = x_size;
     _range.y_size = y_size;
-    _allocate_device_buffer();
+    this->_assign(data, x_size * y_size);
   }
 
-  [[nodiscard]] const cl::Buffer& get_cl_buffer() const { return _device_buffer; }
-
-  void reset(T default_value = static_cast<T>(0)) {
-    std::fill_n(_data, size(), default_value);
-    write_to_device();
+  /**
+   * @brief Copies the x_count * y_count elements starting at (x, y) from the host to the device.
+   */
+  void write_region_to_device(size_t x, size_t y, size_t x_count, size_t y_count, bool blocking = true,
+                              const std::vector<cl::Event>* event_waitlist = nullptr,
+                              cl::Event* event_returned = nullptr) {
+    this->_transfer_region(Profiler::Command::WRITE, {_range.x_size, _range.y_size, 1}, {x, y, 0},
+                           {x_count, y_count, 1}, blocking, event_waitlist, event_returned);
   }
 
-  void write_to_device(bool blocking = true, const std::vector<cl::Event>* event_waitlist = nullptr,
-                       cl::Event* event_returned = nullptr) {
-    cl_int error = _environment->_cl_queue.enqueueWriteBuffer(_device_buffer, blocking, 0, mem_size(), _data, event_waitlist,
-                                               event_returned);
-    check_opencl_error(error);
-  }
-
-  void read_from_device(bool blocking = true, const std::vector<cl::Event>* event_waitlist = nullptr,
-                        cl::Event* event_returned = nullptr) {
-    cl_int error = _environment->_cl_queue.enqueueReadBuffer(_device_buffer, blocking, 0, mem_size(), static_cast<void*>(_data),
-                                              event_waitlist, event_returned);
-    check_opencl_error(error);
+  /**
+   * @brief Copies the x_count * y_count elements starting at (x, y) from the device to the host.
+   */
+  void read_region_from_device(size_t x, size_t y, size_t x_count, size_t y_count, bool blocking = true,
+                               const std::vector<cl::Event>* event_waitlist = nullptr,
+                               cl::Event* event_returned = nullptr) {
+    this->_transfer_region(Profiler::Command::READ, {_range.x_size, _range.y_size, 1}, {x, y, 0},
+                           {x_count, y_count, 1}, blocking, event_waitlist, event_returned);
   }
 
   [[nodiscard]] std::string str() const {
+    this->_check_host_data();
     std::stringstream ss;
-    for (size_t i = 0; i < size() - 1; ++i) {
+    for (size_t i = 0; i < this->size() - 1; ++i) {
       ss << this->operator[](i) << ' ';
     }
-    ss << this->operator[](size() - 1);
+    ss << this->operator[](this->size() - 1);
     return ss.str();
   }
 
  private:
-  [[maybe_unused]] void _allocate_device_buffer() {
-    _environment->_device->_memory_used_Bytes += mem_size();
-    int error = 0;
-    if (_environment->_device->intel_gt_4gb_buffer_required()) {
-      // https://github.com/intel/compute-runtime/blob/master/programmers-guide/ALLOCATIONS_GREATER_THAN_4GB.md
-      _device_buffer =
-          cl::Buffer(_environment->_cl_context, CL_MEM_READ_WRITE | ((int)1 << 23), mem_size(), nullptr, &error);
-    } else {
-      _device_buffer = cl::Buffer(_environment->_cl_context, CL_MEM_READ_WRITE, mem_size(), nullptr, &error);
-    }
-    check_opencl_error(error);
-    _device_buffer_init = true;
-  }
-
-  T* _data;
-  bool _unowned_data{false};
   Range _range;
-  cl::Buffer _device_buffer;
-  bool _device_buffer_init{false};
-  Environment* _environment;
 };
 
 template <typename T>
-class Memory<3, T> {
+class Memory<3, T> : public MemoryBase<T> {
  public:
   struct Range {
     explicit Range(size_t x_size_, size_t y_size_, size_t z_size_)
@@ -227,85 +875,46 @@ class Memory<3, T> {
     size_t y_size;
     size_t z_size;
   };
-  Memory(Environment* environment, T* data, size_t x_size, size_t y_size, size_t z_size)
-      : _environment(environment), _data(data), _range(x_size, y_size, z_size), _unowned_data(true) {}
+  Memory(Environment* environment, T* data, size_t x_size, size_t y_size, size_t z_size,
+         MemoryPolicy policy = MemoryPolicy::PAGEABLE)
+      : MemoryBase<T>(environment, data, x_size * y_size * z_size, policy), _range(x_size, y_size, z_size) {}
 
-  Memory(Environment* environment, size_t x_size, size_t y_size, size_t z_size, T default_value = static_cast<T>(0))
-      : _environment(environment), _range(x_size, y_size, z_size) {
-    _data = new T[size()];
-    std::fill_n(_data, size(), default_value);
-    _allocate_device_buffer();
-  }
-
-  ~Memory() {
-    if (!_unowned_data) {
-      delete[] _data;
-    }
-  }
+  Memory(Environment* environment, size_t x_size, size_t y_size, size_t z_size, T default_value = static_cast<T>(0),
+         MemoryPolicy policy = MemoryPolicy::PAGEABLE)
+      : MemoryBase<T>(environment, x_size * y_size * z_size, default_value, policy), _range(x_size, y_size, z_size) {}
 
-  T* data() { return _data; }
-  const T* data() const { return _data; }
-  [[nodiscard]] size_t size() const { return _range.x_size * _range.y_size * _range.z_size; }
   [[nodiscard]] constexpr unsigned dimension() const { return 3; };
-  [[nodiscard]] size_t mem_size() const { return size() * sizeof(T); }
-  T& operator[](size_t i) { return _data[i]; }
-  const T& operator[](size_t i) const { return _data[i]; }
-  T& at(size_t x, size_t y, size_t z) { return _data[_range.x_size * y + _range.y_size * z + x]; }
-  const T& at(size_t x, size_t y) const { return at(x, y); }
+  T& at(size_t x, size_t y, size_t z) { return (*this)[_range.x_size * (_range.y_size * z + y) + x]; }
+  const T& at(size_t x, size_t y, size_t z) const { return (*this)[_range.x_size * (_range.y_size * z + y) + x]; }
   void assign(T* data, size_t x_size, size_t y_size, size_t z_size) {
-    if (!_unowned_data) {
-      delete[] _data;
-    }
-    _unowned_data = true;
-    _data = data;
     _range.x_size = x_size;
     _range.y_size = y_size;
     _range.z_size = z_size;
-    _allocate_device_buffer();
+    this->_assign(data, x_size * y_size * z_size);
   }
 
-  [[nodiscard]] const cl::Buffer& get_cl_buffer() const { return _device_buffer; }
-
-  void reset(T default_value = static_cast<T>(0)) {
-    std::fill_n(_data, size(), default_value);
-    write_to_device();
+  /**
+   * @brief Copies the x_count * y_count * z_count elements starting at (x, y, z) from the host to the device.
+   */
+  void write_region_to_device(size_t x, size_t y, size_t z, size_t x_count, size_t y_count, size_t z_count,
+                              bool blocking = true, const std::vector<cl::Event>* event_waitlist = nullptr,
+                              cl::Event* event_returned = nullptr) {
+    this->_transfer_region(Profiler::Command::WRITE, {_range.x_size, _range.y_size, _range.z_size}, {x, y, z},
+                           {x_count, y_count, z_count}, blocking, event_waitlist, event_returned);
   }
 
-  void write_to_device(bool blocking = true, const std::vector<cl::Event>* event_waitlist = nullptr,
-                       cl::Event* event_returned = nullptr) {
-    cl_int error = _environment->_cl_queue.enqueueWriteBuffer(_device_buffer, blocking, 0, mem_size(), _data, event_waitlist,
-                                               event_returned);
-    check_opencl_error(error);
-  }
-
-  void read_from_device(bool blocking = true, const std::vector<cl::Event>* event_waitlist = nullptr,
-                        cl::Event* event_returned = nullptr) {
-    cl_int error = _environment->_cl_queue.enqueueReadBuffer(_device_buffer, blocking, 0, mem_size(), static_cast<void*>(_data),
-                                              event_waitlist, event_returned);
-    check_opencl_error(error);
+  /**
+   * @brief Copies the x_count * y_count * z_count elements starting at (x, y, z) from the device to the host.
+   */
+  void read_region_from_device(size_t x, size_t y, size_t z, size_t x_count, size_t y_count, size_t z_count,
+                               bool blocking = true, const std::vector<cl::Event>* event_waitlist = nullptr,
+                               cl::Event* event_returned = nullptr) {
+    this->_transfer_region(Profiler::Command::READ, {_range.x_size, _range.y_size, _range.z_size}, {x, y, z},
+                           {x_count, y_count, z_count}, blocking, event_waitlist, event_returned);
   }
 
  private:
-  [[maybe_unused]] [[maybe_unused]] void _allocate_device_buffer() {
-    _environment->_device->_memory_used_Bytes += mem_size();
-    int error = 0;
-    if (_environment->_device->intel_gt_4gb_buffer_required()) {
-      // https://github.com/intel/compute-runtime/blob/master/programmers-guide/ALLOCATIONS_GREATER_THAN_4GB.md
-      _device_buffer =
-          cl::Buffer(_environment->_cl_context, CL_MEM_READ_WRITE | ((int)1 << 23), mem_size(), nullptr, &error);
-    } else {
-      _device_buffer = cl::Buffer(_environment->_cl_context, CL_MEM_READ_WRITE, mem_size(), nullptr, &error);
-    }
-    check_opencl_error(error);
-    _device_buffer_init = true;
-  }
-
-  T* _data;
-  bool _unowned_data{false};
   Range _range;
-  cl::Buffer _device_buffer;
-  bool _device_buffer_init{false};
-  Environment* _environment;
 };
 
-}  // namespace mcl
\ No newline at end of file
+}  // namespace mcl
@@ -0,0 +1,200 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#include <missocl/environment.h>
+#include <missocl/kernel.h>
+#include <missocl/thread_pool.h>
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+#endif
+#define CL_HPP_ENABLE_EXCEPTIONS
+#include <CL/opencl.hpp>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mcl {
+class Device;
+
+// ===== MultiDeviceExecutor ===========================================================================================
+/**
+ * @brief Runs a kernel data parallel on several devices.
+ *
+ *        The global range is split along its last dimension (1D: work items, 2D: rows) into one contiguous slice per
+ *        device. Argument::split(...) data is scattered accordingly, Argument::broadcast(...) data is copied to every
+ *        device, and written slices are gathered back into the host data. All devices run concurrently.
+ *
+ *        run(...) sizes the slices by Weighting::ESTIMATED_FLOPS (Device::estimated_flops()) or, with
+ *        Weighting::MEASURED_THROUGHPUT, starts that way and then follows the throughput measured in previous runs.
+ *        run_dynamic(...) instead lets every device pull tiles until the range is done, so that no device idles while
+ *        another one finishes a too large slice. Slices and tiles are multiples of the local range, except for the last
+ *        one: kernels must either declare MCL_RANGE_PARAMETERS (see Kernel::set_range(...)) or be run with a divisible
+ *        global range.
+ */
+class MultiDeviceExecutor {
+ public:
+  enum class Weighting { ESTIMATED_FLOPS, MEASURED_THROUGHPUT };
+
+  struct Options {
+    Weighting weighting{Weighting::MEASURED_THROUGHPUT};
+    /// options of the Environments created for the devices (out_of_order is ignored: the queues are in-order)
+    Environment::Options environment{.buffer_pool = true};
+  };
+
+  /**
+   * @brief A kernel argument of MultiDeviceExecutor::run(...).
+   */
+  class Argument {
+    friend class MultiDeviceExecutor;
+
+   public:
+    enum class Access { READ, WRITE, READ_WRITE };
+
+    /**
+     * @brief data is split like the global range: each device gets elements_per_item elements per index of the split
+     *        dimension (1D: per work item, 2D: per row). READ data is scattered, WRITE data gathered. Data of a const T
+     *        is always Access::READ.
+     */
+    template <typename T>
+    static Argument split(T* data, size_t elements_per_item = 1, Access access = Access::READ_WRITE) {
+      return {Kind::SPLIT, const_cast<std::remove_const_t<T>*>(data), sizeof(T), elements_per_item,
+              std::is_const_v<T> ? Access::READ : access};
+    }
+
+    /**
+     * @brief Every device gets a copy of the count elements of data (read only).
+     */
+    template <typename T>
+    static Argument broadcast(const T* data, size_t count) {
+      return {Kind::BROADCAST, const_cast<T*>(data), sizeof(T), count, Access::READ};
+    }
+
+    template <typename T>
+    static Argument scalar(const T& value) {
+      Argument argument{Kind::SCALAR, nullptr, sizeof(T), 1, Access::READ};
+      argument._value.resize(sizeof(T));
+      std::memcpy(argument._value.data(), &value, sizeof(T));
+      return argument;
+    }
+
+    /**
+     * @brief The index of the first item of the slice of a device in the split dimension (ulong).
+     */
+    static Argument offset() { return {Kind::OFFSET, nullptr, sizeof(cl_ulong), 1, Access::READ}; }
+
+   private:
+    enum class Kind { SPLIT, BROADCAST, SCALAR, OFFSET };
+
+    Argument(Kind kind, void* data, size_t element_Bytes, size_t count, Access access)
+        : _kind(kind), _data(data), _element_Bytes(element_Bytes), _count(count), _access(access) {}
+
+    Kind _kind;
+    void* _data;
+    size_t _element_Bytes;
+    /// SPLIT: elements per item, BROADCAST: elements
+    size_t _count;
+    Access _access;
+    /// SCALAR: value
+    std::vector<char> _value;
+  };
+
+  /**
+   * @brief Creates an Environment for each device.
+   */
+  explicit MultiDeviceExecutor(const std::vector<Device*>& devices);
+  MultiDeviceExecutor(const std::vector<Device*>& devices, Options options);
+
+  /**
+   * @brief Builds the kernel name of cl_c_source for all devices.
+   */
+  void add_kernel(std::string name, const std::string& cl_c_source);
+
+  /**
+   * @brief Sets the local range of the kernel on all devices (default: WORKGROUP_SIZE in the split dimension).
+   */
+  void set_local_range(cl::NDRange local_range);
+
+  /**
+   * @brief Runs the kernel with global_range (1 or 2 dimensions) and arguments on all devices and blocks until all
+   *        written slices are gathered.
+   */
+  void run(cl::NDRange global_range, const std::vector<Argument>& arguments);
+
+  /**
+   * @brief Same as run(...), but the global range is processed in tiles that the devices pull from a shared queue.
+   *
+   *        A device claims half of its share of the remaining items per tile (at least min_tile_items), where the
+   *        share follows the per device throughput learned from all previous tiles and runs. Large tiles at the
+   *        beginning keep the per tile overhead low, small tiles at the end balance the finish. Every tile is
+   *        transferred and run separately, Argument::broadcast(...) data is uploaded once per device.
+   */
+  void run_dynamic(cl::NDRange global_range, const std::vector<Argument>& arguments, size_t min_tile_items = 0);
+
+  /**
+   * @brief Returns the share of the global range per device used by the next run(...).
+   */
+  [[nodiscard]] const std::vector<double>& get_weights() const;
+
+  /**
+   * @brief Returns the learned throughput per device in items (of the split dimension) per second, 0 if not measured.
+   */
+  [[nodiscard]] std::vector<double> get_throughput() const;
+
+  [[nodiscard]] size_t device_count() const;
+  Environment& get_environment(size_t device_index);
+  Kernel& get_kernel(size_t device_index);
+
+ private:
+  /// validates global_range and returns the items of its split dimension and their granularity (local range)
+  size_t _split_items(const cl::NDRange& global_range, size_t& granularity) const;
+  /// splits items into one slice per device: multiples of granularity, following _weights
+  [[nodiscard]] std::vector<size_t> _partition(size_t items, size_t granularity) const;
+  /// device buffer of an argument, reused by all slices of a device in one run
+  struct SliceBuffer {
+    cl::Buffer buffer;
+    size_t size_Bytes{0};
+  };
+
+  /// runs the slice [first, first + items) on device d and blocks until it is finished
+  void _run_slice(size_t d, const cl::NDRange& global_range, size_t first, size_t items,
+                  const std::vector<Argument>& arguments, std::vector<SliceBuffer>& buffers);
+  void _release_buffer(size_t d, SliceBuffer& buffer);
+  /// calls work with the slice buffers of device d and releases them afterwards
+  void _run_device(size_t d, const std::function<void(std::vector<SliceBuffer>&)>& work);
+  static void _wait(std::vector<std::future<void>>& done);
+
+  [[nodiscard]] size_t _tile_items(size_t d, size_t remaining_items, size_t granularity, size_t min_tile) const;
+  /// share of device d: by learned throughput if measured, else by weight
+  [[nodiscard]] double _share(size_t d) const;
+  void _learn(size_t d, size_t items, double seconds);
+  /// sets the weights to the current shares
+  void _update_weights();
+
+  Options _options;
+  std::vector<std::unique_ptr<Environment>> _environments;
+  std::vector<Kernel> _kernels;
+  cl::NDRange _local_range{cl::NullRange};
+  std::vector<double> _weights;
+  std::vector<double> _throughput;
+  mutable std::mutex _throughput_mutex;
+  ThreadPool _workers;
+};
+
+}  // namespace mcl
@@ -11,10 +11,21 @@
 
 #pragma once
 
+#include <missocl/buffer_pool.h>
 #include <missocl/device.h>
 #include <missocl/environment.h>
 #include <missocl/kernel.h>
+#include <missocl/launch_batch.h>
+#include <missocl/mapped_file.h>
 #include <missocl/memory.h>
+#include <missocl/multi_device.h>
+#include <missocl/profiler.h>
+#include <missocl/program_cache.h>
+#include <missocl/stream_executor.h>
+#include <missocl/task_graph.h>
+#include <missocl/thread_pool.h>
+#include <missocl/tuning.h>
+#include <missocl/typed_kernel.h>
 #include <missocl/utils.h>
 
 #ifndef CL_HPP_TARGET_OPENCL_VERSION
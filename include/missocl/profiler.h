@@ -0,0 +1,140 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+#endif
+#define CL_HPP_ENABLE_EXCEPTIONS
+#include <CL/opencl.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mcl {
+
+// ===== Profiler ======================================================================================================
+/**
+ * @brief Collects device side timings of the commands enqueued through an Environment.
+ *
+ *        Recording is enabled by creating the Environment with Environment::Options::profiling set to true. Every
+ *        Kernel::enqueue_run(...), Memory::write_to_device(...), Memory::read_from_device(...),
+ *        Memory::fill_device(...) and Memory::copy_to(...) is then recorded with its
+ *        CL_PROFILING_COMMAND_(QUEUED|SUBMIT|START|END) timestamps.
+ */
+class Profiler {
+ public:
+  enum class Command { KERNEL, WRITE, READ, FILL, COPY };
+
+  /**
+   * @brief A single recorded command. Timestamps are device times in nanoseconds.
+   */
+  struct Record {
+    Command command;
+    /// kernel name or Memory name
+    std::string name;
+    unsigned queue_index{0};
+    /// Bytes transferred (WRITE, READ), copied (COPY), filled (FILL) or set by Kernel::set_work_per_run(...) (KERNEL)
+    uint64_t bytes{0};
+    /// set by Kernel::set_work_per_run(...)
+    uint64_t flops{0};
+    /// global and local NDRange of a KERNEL command (empty for transfers and for a NullRange local range)
+    std::vector<cl::size_type> global_range{};
+    std::vector<cl::size_type> local_range{};
+    /// set by Profiler::record(...): host thread and host time (std::chrono::steady_clock, ns) of the enqueue
+    std::thread::id host_thread{};
+    uint64_t host_enqueue_ns{0};
+    cl_ulong queued{0};
+    cl_ulong submit{0};
+    cl_ulong start{0};
+    cl_ulong end{0};
+
+    [[nodiscard]] cl_ulong duration_ns() const { return end - start; }
+  };
+
+  /**
+   * @brief Aggregated timings of all records with the same command and name.
+   */
+  struct Statistics {
+    Command command;
+    std::string name;
+    size_t count{0};
+    double min_ms{0};
+    double mean_ms{0};
+    double p99_ms{0};
+    double total_ms{0};
+    uint64_t bytes{0};
+    uint64_t flops{0};
+
+    /// effective bandwidth in GB/s (0 if no bytes were recorded)
+    [[nodiscard]] double gb_per_s() const;
+    /// effective throughput in GFLOP/s (0 if no flops were recorded)
+    [[nodiscard]] double gflop_per_s() const;
+  };
+
+  /**
+   * @brief Adds the command of event described by record. Its timestamps are read once it has finished.
+   *
+   *        Must be called by the thread that enqueued the command, right after enqueueing it.
+   */
+  void record(Record record, cl::Event event);
+
+  /**
+   * @brief Returns all records in the order they were enqueued. Blocks until all recorded commands finished.
+   */
+  std::vector<Record> records();
+
+  /**
+   * @brief Returns the statistics per kernel name and per Memory name. Blocks until all recorded commands finished.
+   */
+  std::vector<Statistics> statistics();
+
+  /**
+   * @brief Prints statistics() as table.
+   */
+  void print(std::ostream& os);
+
+  /**
+   * @brief Writes all records as Chrome trace (JSON trace event format) to file. Blocks until all recorded commands
+   *        finished.
+   *
+   *        The trace can be opened with chrome://tracing or https://ui.perfetto.dev. Every command is a slice on the
+   *        track of its command queue, annotated with kernel name, NDRange and Bytes. The host side enqueue of every
+   *        command is shown as instant event on the track of the enqueueing host thread.
+   */
+  void write_chrome_trace(const std::filesystem::path& file, const std::string& device_name = "OpenCL Device");
+
+  /**
+   * @brief Removes all records.
+   */
+  void clear();
+
+ private:
+  void _resolve();
+
+  struct PendingRecord {
+    Record record;
+    cl::Event event;
+  };
+
+  std::mutex _mutex;
+  std::vector<PendingRecord> _pending;
+  std::vector<Record> _records;
+};
+
+std::ostream& operator<<(std::ostream& os, const Profiler::Command& command);
+
+}  // namespace mcl
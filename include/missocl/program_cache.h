@@ -0,0 +1,100 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+#endif
+#define CL_HPP_ENABLE_EXCEPTIONS
+#include <CL/opencl.hpp>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+
+namespace mcl {
+class Device;
+
+// ===== ProgramCache ==================================================================================================
+/**
+ * @brief Persistent on-disk cache for built OpenCL programs.
+ *
+ *        Programs are stored as CL_PROGRAM_BINARIES and keyed by a hash of the source, the build options and the
+ *        name, driver version and OpenCL C version of the device. A cached binary is loaded with
+ *        clCreateProgramWithBinary. If the driver rejects it, the program is rebuilt from source and the cache entry is
+ *        replaced.
+ *
+ *        The cache is disabled as long as no directory is set. The initial directory is
+ *        mcl::default_cache_directory() / "programs".
+ */
+class ProgramCache {
+ public:
+  /**
+   * @brief Sets the directory cached binaries are stored in. An empty path disables the cache.
+   */
+  static void set_directory(std::filesystem::path directory);
+
+  /**
+   * @brief Returns the directory cached binaries are stored in (empty if the cache is disabled).
+   */
+  static std::filesystem::path get_directory();
+
+  /**
+   * @brief Returns true if a cache directory is set.
+   */
+  static bool enabled();
+
+  /**
+   * @brief Returns the number of programs that were loaded from a cached binary.
+   */
+  static uint64_t hits();
+
+  /**
+   * @brief Returns the number of programs that had to be built from source while the cache was enabled.
+   *
+   *        This includes binaries that were found on disk but rejected by the driver.
+   */
+  static uint64_t misses();
+
+  /**
+   * @brief Resets hits() and misses() to 0.
+   */
+  static void reset_statistics();
+
+  /**
+   * @brief Returns a program built for device, either loaded from the cache or built from source.
+   *
+   *        Throws mcl::OpenCLError (or cl::BuildError) if the program can not be built from source.
+   */
+  static cl::Program build(const cl::Context& context, const Device& device, const std::string& source,
+                           const std::string& build_options);
+
+ private:
+  ProgramCache();
+  static ProgramCache& get_instance();
+
+  static uint64_t _key(const Device& device, const std::string& source, const std::string& build_options);
+  static cl::Program _build_from_source(const cl::Context& context, const Device& device, const std::string& source,
+                                        const std::string& build_options);
+
+  bool _load(const std::filesystem::path& file, uint64_t key, const cl::Context& context, const Device& device,
+             const std::string& build_options, cl::Program& program);
+  void _store(const std::filesystem::path& file, uint64_t key, const Device& device, const cl::Program& program);
+
+  std::mutex _mutex;
+  std::filesystem::path _directory;
+  std::atomic<uint64_t> _hits{0};
+  std::atomic<uint64_t> _misses{0};
+};
+
+}  // namespace mcl
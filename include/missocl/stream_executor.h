@@ -0,0 +1,85 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+#endif
+#define CL_HPP_ENABLE_EXCEPTIONS
+#include <CL/opencl.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace mcl {
+class Environment;
+class Kernel;
+
+// ===== StreamExecutor ================================================================================================
+/**
+ * @brief Runs a Kernel over host data that does not need to fit into device memory.
+ *
+ *        The input is split into chunks that are uploaded, processed and downloaded in a pipeline: while chunk i is
+ *        processed, chunk i + 1 is uploaded and chunk i - 1 is downloaded. The kernel is enqueued to its queue (see
+ *        Kernel::set_queue(...)), transfers use the other queues of the Environment, so create it with
+ *        Environment::Options::queue_count = 3 to overlap all three stages.
+ *
+ *        The first three kernel parameters are set per chunk and must be
+ *
+ *          __kernel void f(__global const IN* in, __global OUT* out, const ulong count, ...)
+ *
+ *        where count is the number of elements of the chunk. Further parameters can be set with
+ *        Kernel::set_arg(...). The global range of the kernel is set to the chunk size rounded up to its local range,
+ *        so the kernel must discard work items with get_global_id(0) >= count (or declare MCL_RANGE_PARAMETERS).
+ */
+class StreamExecutor {
+ public:
+  struct Options {
+    /// number of chunks in flight: 2 for double buffering, 3 for triple buffering
+    unsigned depth{3};
+    /// elements per chunk (0: derived from the available device memory and Device::max_global_buffer_Bytes())
+    size_t chunk_size{0};
+  };
+
+  StreamExecutor(Environment& environment, Kernel& kernel);
+  StreamExecutor(Environment& environment, Kernel& kernel, Options options);
+
+  /**
+   * @brief Runs the kernel on input[0, count) and writes the results to output[0, count). Blocks until all chunks
+   *        are downloaded.
+   *
+   *        Transfers from and to pinned host memory (e.g. the data of a MemoryPolicy::HOST_ONLY Memory) overlap best.
+   */
+  template <typename In, typename Out>
+  void run(const In* input, Out* output, size_t count) {
+    _run(input, sizeof(In), output, sizeof(Out), count);
+  }
+
+  template <typename In, typename Out>
+  void run(const std::vector<In>& input, std::vector<Out>& output) {
+    output.resize(input.size());
+    run(input.data(), output.data(), input.size());
+  }
+
+  /**
+   * @brief Returns the number of elements per chunk for the given element sizes.
+   */
+  [[nodiscard]] size_t chunk_size(size_t input_element_Bytes, size_t output_element_Bytes) const;
+
+ private:
+  void _run(const void* input, size_t input_element_Bytes, void* output, size_t output_element_Bytes, size_t count);
+
+  Environment* _environment;
+  Kernel* _kernel;
+  Options _options;
+};
+
+}  // namespace mcl
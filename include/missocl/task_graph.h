@@ -0,0 +1,184 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+#endif
+#define CL_HPP_ENABLE_EXCEPTIONS
+#include <CL/opencl.hpp>
+#include <missocl/environment.h>
+#include <missocl/memory.h>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mcl {
+class Kernel;
+
+// ===== TaskGraph =====================================================================================================
+/**
+ * @brief A sequence of kernel runs, transfers, fills and host functions whose dependencies are inferred from the
+ *        Memory objects they read and write. The graph is built once and launched (replayed) any number of times.
+ *
+ *        Every Memory has a device side and a host side: an upload reads the host side and writes the device side, a
+ *        download reads the device side and writes the host side, fills and kernels access the device side and host
+ *        functions the host side. A node depends on the last node writing what it reads and on all nodes accessing
+ *        what it writes since that write, also across launches (an upload of launch i + 1 waits for the kernels of
+ *        launch i reading the buffer).
+ *
+ *        Kernels are enqueued to their queue (see Kernel::set_queue(...)) and fills to the queue of their Memory as set
+ *        when the node is added (later set_queue(...) calls do not affect the graph), uploads to queue 1 and downloads
+ *        to queue 2 of the Environment (if available), so create the Environment with
+ *        Environment::Options::queue_count = 3 to overlap transfers with kernel runs. Dependencies within an in-order
+ *        queue are implicit and of multiple dependencies on one other queue only the last one is waited for: events
+ *        are only created and waited for where queues actually have to synchronize. The wait lists are computed on the
+ *        first launch after a node was added and reused by all further launches; the graph never sets kernel
+ *        arguments, so launching it costs the enqueue calls only.
+ *
+ *        Uploads and downloads do not block: host data must not be accessed outside of host nodes until finish().
+ */
+class TaskGraph {
+ public:
+  using Node = size_t;
+
+  explicit TaskGraph(Environment& environment);
+
+  /**
+   * @brief Adds runs runs of kernel (Kernel::enqueue_run(...)). reads and writes are the Memory objects bound to the
+   *        kernel (a Memory that is read and written is listed in both).
+   */
+  Node add_kernel(Kernel& kernel, std::vector<const MemoryObject*> reads, std::vector<const MemoryObject*> writes,
+                  unsigned runs = 1);
+
+  /**
+   * @brief Adds copying the host data of memory to the device (non-blocking MemoryBase::write_to_device(...)).
+   */
+  template <typename T>
+  Node add_upload(MemoryBase<T>& memory) {
+    return _add({Kind::UPLOAD, "upload " + memory.get_name(), _upload_queue(),
+                 [&memory](unsigned queue, const std::vector<cl::Event>* waitlist, cl::Event* event) {
+                   auto memory_queue = memory.get_queue();
+                   memory.set_queue(queue);
+                   memory.write_to_device(false, waitlist, event);
+                   memory.set_queue(memory_queue);
+                 },
+                 {{&memory, true}}, {{&memory, false}}});
+  }
+
+  /**
+   * @brief Adds copying the device data of memory to the host (non-blocking MemoryBase::read_from_device(...)).
+   */
+  template <typename T>
+  Node add_download(MemoryBase<T>& memory) {
+    return _add({Kind::DOWNLOAD, "download " + memory.get_name(), _download_queue(),
+                 [&memory](unsigned queue, const std::vector<cl::Event>* waitlist, cl::Event* event) {
+                   auto memory_queue = memory.get_queue();
+                   memory.set_queue(queue);
+                   memory.read_from_device(false, waitlist, event);
+                   memory.set_queue(memory_queue);
+                 },
+                 {{&memory, false}}, {{&memory, true}}});
+  }
+
+  /**
+   * @brief Adds filling the device buffer of memory with value (MemoryBase::fill_device(...)).
+   */
+  template <typename T>
+  Node add_fill(MemoryBase<T>& memory, T value) {
+    return _add({Kind::FILL, "fill " + memory.get_name(), memory.get_queue(),
+                 [&memory, value](unsigned queue, const std::vector<cl::Event>* waitlist, cl::Event* event) {
+                   auto memory_queue = memory.get_queue();
+                   memory.set_queue(queue);
+                   memory.fill_device(value, waitlist, event);
+                   memory.set_queue(memory_queue);
+                 },
+                 {}, {{&memory, false}}});
+  }
+
+  /**
+   * @brief Adds a function called on the launching thread once the nodes it depends on are finished. reads and
+   *        writes are the Memory objects whose host data function accesses.
+   */
+  Node add_host(std::function<void()> function, std::vector<const MemoryObject*> reads,
+                std::vector<const MemoryObject*> writes);
+
+  /**
+   * @brief Enqueues all nodes in the order they were added and flushes the queues. Returns once the last node is
+   *        enqueued (host nodes are executed in between).
+   */
+  void launch();
+
+  /**
+   * @brief Launches the graph iterations times and blocks until all nodes are finished.
+   */
+  void run(unsigned iterations = 1);
+
+  /**
+   * @brief Blocks until all launched nodes are finished.
+   */
+  void finish();
+
+  [[nodiscard]] size_t size() const;
+
+  /**
+   * @brief Returns the nodes node waits for on launch: the inferred dependencies without the implicit ones. Nodes of
+   *        the previous launch are returned as well (the dependencies of the first launch are a subset).
+   */
+  [[nodiscard]] std::vector<Node> waits(Node node);
+
+ private:
+  enum class Kind { KERNEL, UPLOAD, DOWNLOAD, FILL, HOST };
+
+  /// side of a Memory accessed by a node: false for the device buffer, true for the host data
+  struct Access {
+    const MemoryObject* memory;
+    bool host;
+
+    bool operator<(const Access& other) const;
+  };
+
+  struct NodeData {
+    Kind kind;
+    std::string name;
+    /// queue index (ignored for host nodes)
+    unsigned queue;
+    /// enqueues the node (host nodes: calls the function)
+    std::function<void(unsigned queue, const std::vector<cl::Event>* waitlist, cl::Event* event)> enqueue;
+    std::vector<Access> reads;
+    std::vector<Access> writes;
+    /// set by _compile(): nodes whose events are waited for (< size(): node of the previous launch, else node + size()
+    /// of the current launch), and whether other nodes wait for this node's event
+    std::vector<size_t> waits{};
+    bool signals{false};
+  };
+
+  Node _add(NodeData node);
+  static std::vector<Access> _device_access(const std::vector<const MemoryObject*>& memory);
+  static std::vector<Access> _host_access(const std::vector<const MemoryObject*>& memory);
+  [[nodiscard]] unsigned _upload_queue() const;
+  [[nodiscard]] unsigned _download_queue() const;
+  /// infers the dependencies and computes the wait lists
+  void _compile();
+
+  Environment* _environment;
+  std::vector<NodeData> _nodes;
+  bool _compiled{false};
+  /// event of every node of the current and of the previous launch (null for nodes nobody waits for)
+  std::vector<cl::Event> _events;
+  std::vector<cl::Event> _previous_events;
+  std::vector<cl::Event> _waitlist;
+};
+
+}  // namespace mcl
@@ -0,0 +1,73 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace mcl {
+
+// ===== ThreadPool ====================================================================================================
+/**
+ * @brief A fixed size pool of worker threads executing submitted tasks in FIFO order.
+ */
+class ThreadPool {
+ public:
+  /**
+   * @brief Creates a pool of num_threads workers (std::thread::hardware_concurrency() if 0).
+   */
+  explicit ThreadPool(size_t num_threads = 0);
+  /// Waits for all submitted tasks to finish.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @brief Returns the process wide pool used by miss-ocl (e.g. for Environment::add_kernel_async(...)).
+   */
+  static ThreadPool& global();
+
+  /**
+   * @brief Runs task on one of the workers. Exceptions thrown by the task are stored in the returned future.
+   */
+  template <typename F>
+  auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+    using R = std::invoke_result_t<std::decay_t<F>>;
+    auto packaged_task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+    auto future = packaged_task->get_future();
+    _push([packaged_task]() { (*packaged_task)(); });
+    return future;
+  }
+
+  [[nodiscard]] size_t size() const;
+
+ private:
+  void _push(std::function<void()> task);
+  void _work();
+
+  std::vector<std::thread> _workers;
+  std::queue<std::function<void()>> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  bool _stop{false};
+};
+
+}  // namespace mcl
@@ -0,0 +1,75 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+#endif
+#define CL_HPP_ENABLE_EXCEPTIONS
+#include <CL/opencl.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mcl {
+
+// ===== TuningDatabase ================================================================================================
+/**
+ * @brief Persistent store of the local ranges chosen by Kernel::autotune(...).
+ *
+ *        Entries are keyed by device name, driver version, kernel name, program source and global range. The database
+ *        is a text file that is read on first access and rewritten on every store(...). An empty file path keeps the
+ *        database in memory only. The initial file is mcl::default_cache_directory() / "tuning.db".
+ */
+class TuningDatabase {
+ public:
+  /**
+   * @brief Sets the file the database is persisted to and drops all entries that were loaded from the previous file.
+   */
+  static void set_file(std::filesystem::path file);
+  static std::filesystem::path get_file();
+
+  /**
+   * @brief Returns the stored local range for key. An empty vector stands for cl::NullRange (driver choice).
+   */
+  static std::optional<std::vector<cl::size_type>> load(const std::string& key);
+
+  /**
+   * @brief Stores local_range for key and persists the database.
+   */
+  static void store(const std::string& key, const std::vector<cl::size_type>& local_range);
+
+  /**
+   * @brief Builds the key of a kernel: all fields are joined, tabs and newlines are replaced.
+   */
+  static std::string make_key(const std::string& device_name, const std::string& driver_version,
+                              const std::string& kernel_name, uint64_t program_hash, const cl::NDRange& global_range);
+
+ private:
+  TuningDatabase();
+  static TuningDatabase& get_instance();
+
+  void _read();
+  void _merge_file();
+  void _write();
+
+  std::mutex _mutex;
+  std::filesystem::path _file;
+  bool _read_done{false};
+  std::unordered_map<std::string, std::vector<cl::size_type>> _entries;
+};
+
+}  // namespace mcl
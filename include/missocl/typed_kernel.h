@@ -0,0 +1,177 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#pragma once
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 200
+#endif
+#define CL_HPP_ENABLE_EXCEPTIONS
+#include <CL/opencl.hpp>
+#include <missocl/kernel.h>
+#include <missocl/memory.h>
+#include <missocl/utils.h>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mcl {
+
+template <typename T>
+struct is_memory : std::false_type {};
+
+template <unsigned dimension, typename T>
+struct is_memory<Memory<dimension, T>> : std::true_type {};
+
+/**
+ * @brief Types a kernel argument of a TypedKernel can have: Memory<N, T> for __global buffers and trivially copyable
+ *        scalars or structs for values. Pointers and bool have no defined size on the device and are rejected.
+ */
+template <typename T>
+constexpr bool is_kernel_argument_v =
+    is_memory<T>::value ||
+    (std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> && !std::is_same_v<T, bool> && !std::is_reference_v<T>);
+
+// ===== TypedKernel ===================================================================================================
+/**
+ * @brief A Kernel with a signature known at compile time: TypedKernel<Memory<1, float>, cl_uint> is a kernel taking a
+ *        buffer and an unsigned int (MCL_RANGE_PARAMETERS are not part of the signature).
+ *
+ *        Argument types are checked by the compiler and arguments are set by their index, the number of arguments is
+ *        checked against the kernel when the TypedKernel is created. Every argument is cached: setting an argument to
+ *        the value (or Memory) it already has does not call clSetKernelArg, so set_args(...) can be called before
+ *        every launch at no cost for the unchanged arguments.
+ *
+ *          auto saxpy = mcl::TypedKernel<mcl::Memory<1, float>, mcl::Memory<1, float>, float>(
+ *              env.add_kernel(cl::NDRange(n), "saxpy", code));
+ *          saxpy.set_args(x, y, 2.0f);
+ *          saxpy.run();
+ *
+ *        Arguments must only be set through the TypedKernel, otherwise the cache is outdated.
+ */
+template <typename... Args>
+class TypedKernel {
+  static_assert((is_kernel_argument_v<Args> && ...),
+                "TypedKernel: arguments must be mcl::Memory or trivially copyable non-pointer, non-bool values");
+
+ public:
+  static constexpr size_t argument_count = sizeof...(Args);
+
+  template <size_t I>
+  using argument_type = std::tuple_element_t<I, std::tuple<Args...>>;
+
+  /**
+   * @brief Throws std::runtime_error if kernel does not take sizeof...(Args) arguments (without MCL_RANGE_PARAMETERS).
+   */
+  explicit TypedKernel(Kernel kernel) : _kernel(std::move(kernel)) {
+    if (_kernel.argument_count() != argument_count) {
+      throw std::runtime_error("TypedKernel: kernel " + _kernel.get_name() + " takes " +
+                               std::to_string(_kernel.argument_count()) + " arguments, the signature declares " +
+                               std::to_string(argument_count) + ".");
+    }
+  }
+
+  /**
+   * @brief Sets argument I. Calls clSetKernelArg only if the argument changed since it was set last.
+   */
+  template <size_t I>
+    requires(I < argument_count)
+  void set(const argument_type<I>& arg) {
+    auto& cached = std::get<I>(_cache);
+    if constexpr (is_memory<argument_type<I>>::value) {
+      // a kernel may write every bound buffer, so coherent Memory is synchronized by the launches (coherent() is
+      // checked on every launch)
+      auto* memory = const_cast<argument_type<I>*>(&arg);
+      if (cached.set && cached.buffer() == arg.get_cl_buffer()() && cached.memory == memory) {
+        return;
+      }
+      _kernel._bind_memory(I, memory);
+      check_opencl_error(_kernel._cl_kernel.setArg(I, arg.get_cl_buffer()));
+      cached = {true, arg.get_cl_buffer(), memory};
+    } else {
+      if (cached.set && std::memcmp(cached.value.data(), &arg, sizeof(arg)) == 0) {
+        return;
+      }
+      check_opencl_error(_kernel._cl_kernel.setArg(I, arg));
+      cached.set = true;
+      std::memcpy(cached.value.data(), &arg, sizeof(arg));
+    }
+  }
+
+  /**
+   * @brief Sets all arguments (see set<I>(...)).
+   */
+  void set_args(const Args&... args) { _set_args(std::index_sequence_for<Args...>{}, args...); }
+
+  /**
+   * @brief Kernel::enqueue_run(...), throws std::runtime_error if an argument was not set.
+   */
+  void enqueue_run(unsigned t = 1, const std::vector<cl::Event>* event_waitlist = nullptr,
+                   cl::Event* event_returned = nullptr) {
+    _check_arguments_set();
+    _kernel.enqueue_run(t, event_waitlist, event_returned);
+  }
+
+  /**
+   * @brief Kernel::run(...), throws std::runtime_error if an argument was not set.
+   */
+  void run(unsigned t = 1, const std::vector<cl::Event>* event_waitlist = nullptr,
+           cl::Event* event_returned = nullptr) {
+    _check_arguments_set();
+    _kernel.run(t, event_waitlist, event_returned);
+  }
+
+  /**
+   * @brief Returns the underlying Kernel to set range and queue, autotune it or add it to a LaunchBatch or TaskGraph.
+   */
+  [[nodiscard]] Kernel& kernel() { return _kernel; }
+  [[nodiscard]] const Kernel& kernel() const { return _kernel; }
+
+ private:
+  template <typename T, bool memory = is_memory<T>::value>
+  struct Cached {
+    bool set{false};
+    /// bytes of the value: T is trivially copyable, but may not be default constructible
+    std::array<unsigned char, sizeof(T)> value{};
+  };
+
+  template <typename T>
+  struct Cached<T, true> {
+    bool set{false};
+    /// retains the buffer: its handle can not be reused for another buffer while it is cached
+    cl::Buffer buffer{};
+    MemoryObject* memory{nullptr};
+  };
+
+  template <size_t... I>
+  void _set_args(std::index_sequence<I...>, const Args&... args) {
+    (set<I>(args), ...);
+  }
+
+  void _check_arguments_set() const {
+    bool set = std::apply([](const auto&... cached) { return (cached.set && ...); }, _cache);
+    if (!set) {
+      throw std::runtime_error("TypedKernel: not all arguments of kernel " + _kernel.get_name() + " are set.");
+    }
+  }
+
+  Kernel _kernel;
+  std::tuple<Cached<Args>...> _cache;
+};
+
+}  // namespace mcl
@@ -12,7 +12,12 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <ostream>
 #include <stdexcept>
 
 #ifndef CL_HPP_TARGET_OPENCL_VERSION
@@ -37,8 +42,55 @@ class OpenCLError : public std::exception {
   std::string _message;
 };
 
+/**
+ * @brief Thrown if an allocation would exceed the memory budget of a Device (see Device::set_memory_budget(...)).
+ */
+class MemoryBudgetError : public std::exception {
+ public:
+  explicit MemoryBudgetError(std::string message) : _message(std::move(message)) {}
+
+  [[nodiscard]] const char* what() const noexcept override {
+    return _message.c_str();
+  }
+
+ private:
+  std::string _message;
+};
+
 void check_opencl_error(cl_int error);
 
+/**
+ * @brief 64 bit FNV-1a hash of data. Pass a previous result as hash to chain multiple inputs.
+ *
+ *        Unlike std::hash, the result is stable across processes and platforms and can be used as on-disk cache key.
+ */
+uint64_t fnv1a_64(std::string_view data, uint64_t hash = 0xcbf29ce484222325ULL);
+
+/**
+ * @brief Returns the directory persistent caches of miss-ocl are stored in by default.
+ *
+ *        The directory is read from the environment variable MISSOCL_CACHE_DIR. If it is not set, an empty path is
+ *        returned and persistent caching is disabled unless a directory is configured explicitly.
+ */
+std::filesystem::path default_cache_directory();
+
+/**
+ * @brief Replaces file by what write(...) writes. The content is written to a temporary file unique to this process
+ *        and call first and renamed to file afterwards, so that concurrent processes never read partial files. Missing
+ *        parent directories are created.
+ *
+ * @return false if the file could not be written (write(...) returning false discards the file)
+ */
+bool write_file_atomically(const std::filesystem::path& file, const std::function<bool(std::ostream&)>& write,
+                           bool binary = false);
+
+/**
+ * @brief Calls entry(key, value) for every line "<key>\t<value>" of file. Missing files and lines without a tab are
+ *        ignored.
+ */
+void read_key_value_file(const std::filesystem::path& file,
+                         const std::function<void(const std::string& key, const std::string& value)>& entry);
+
 class Timer {
   typedef std::chrono::high_resolution_clock clock;
  public:
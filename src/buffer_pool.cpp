@@ -0,0 +1,89 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/buffer_pool.h>
+#include <missocl/utils.h>
+
+#include <algorithm>
+#include <bit>
+
+namespace mcl {
+
+// ===== BufferPool ====================================================================================================
+double BufferPool::Statistics::fragmentation() const {
+  uint64_t allocated = in_use_Bytes + cached_Bytes;
+  return allocated > 0 ? 1.0 - static_cast<double>(requested_Bytes) / static_cast<double>(allocated) : 0;
+}
+
+cl::Buffer BufferPool::acquire(size_t size_Bytes, cl_mem_flags flags) {
+  size_t size = size_class(size_Bytes);
+  std::lock_guard lock(_mutex);
+  auto it = _cached.find({flags, size});
+  if (it == _cached.end() || it->second.empty()) {
+    return {};
+  }
+  cl::Buffer buffer = std::move(it->second.back());
+  it->second.pop_back();
+  _statistics.reuses++;
+  _statistics.cached_Bytes -= size;
+  _statistics.in_use_Bytes += size;
+  _statistics.requested_Bytes += size_Bytes;
+  return buffer;
+}
+
+cl::Buffer BufferPool::allocate(const cl::Context& context, size_t size_Bytes, cl_mem_flags flags) {
+  size_t size = size_class(size_Bytes);
+  // allocate outside of the lock: driver allocations may take a while
+  int error = 0;
+  cl::Buffer buffer(context, flags, size, nullptr, &error);
+  check_opencl_error(error);
+  std::lock_guard lock(_mutex);
+  _statistics.allocations++;
+  _statistics.in_use_Bytes += size;
+  _statistics.requested_Bytes += size_Bytes;
+  _statistics.high_water_Bytes =
+      std::max(_statistics.high_water_Bytes, _statistics.in_use_Bytes + _statistics.cached_Bytes);
+  return buffer;
+}
+
+void BufferPool::release(cl::Buffer buffer, size_t size_Bytes, cl_mem_flags flags) {
+  size_t size = size_class(size_Bytes);
+  std::lock_guard lock(_mutex);
+  _cached[{flags, size}].push_back(std::move(buffer));
+  _statistics.in_use_Bytes -= size;
+  _statistics.requested_Bytes -= size_Bytes;
+  _statistics.cached_Bytes += size;
+}
+
+size_t BufferPool::trim() {
+  std::lock_guard lock(_mutex);
+  size_t freed = _statistics.cached_Bytes;
+  _cached.clear();
+  _statistics.cached_Bytes = 0;
+  return freed;
+}
+
+BufferPool::Statistics BufferPool::statistics() const {
+  std::lock_guard lock(_mutex);
+  return _statistics;
+}
+
+size_t BufferPool::size_class(size_t size_Bytes) {
+  constexpr size_t min_size = 256;
+  if (size_Bytes <= min_size) {
+    return min_size;
+  }
+  // four classes per power of two: at most 25 % of a buffer is unused
+  size_t step = std::bit_floor(size_Bytes) / 4;
+  return (size_Bytes + step - 1) / step * step;
+}
+
+}  // namespace mcl
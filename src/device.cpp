@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <missocl/device.h>
+#include <missocl/utils.h>
 
 namespace mcl {
 
@@ -24,17 +25,27 @@ Device::Device(Device&& device) noexcept
     : _instructions_per_cycle(device._instructions_per_cycle),
       _cores(device._cores),
       _id(device._id),
+      _parent(device._parent),
       _intel_gt_4gb_buffer_required(device._intel_gt_4gb_buffer_required),
-      _memory_used_Bytes(device._memory_used_Bytes),
+      _memory_used_Bytes(device._memory_used_Bytes.load()),
+      _memory_peak_Bytes(device._memory_peak_Bytes.load()),
+      _memory_budget_Bytes(device._memory_budget_Bytes.load()),
+      _budget_callback(std::move(device._budget_callback)),
+      _characteristics(std::move(device._characteristics)),
       _cl_device(std::move(device._cl_device)) {}
 
 Device& Device::operator=(mcl::Device&& device) noexcept {
   _cl_device = std::move(device._cl_device);
   _intel_gt_4gb_buffer_required = device._intel_gt_4gb_buffer_required;
   _id = device._id;
+  _parent = device._parent;
   _cores = device._cores;
   _instructions_per_cycle = device._instructions_per_cycle;
-  _memory_used_Bytes = device._memory_used_Bytes;
+  _memory_used_Bytes = device._memory_used_Bytes.load();
+  _memory_peak_Bytes = device._memory_peak_Bytes.load();
+  _memory_budget_Bytes = device._memory_budget_Bytes.load();
+  _budget_callback = std::move(device._budget_callback);
+  _characteristics = std::move(device._characteristics);
   return *this;
 }
 
@@ -56,12 +67,36 @@ uint64_t Device::memory_Bytes() const { return _cl_device.getInfo<CL_DEVICE_GLOB
 
 uint64_t Device::memory_used_Bytes() const { return _memory_used_Bytes; }
 
+uint64_t Device::memory_peak_Bytes() const { return _memory_peak_Bytes; }
+
+void Device::reset_memory_peak() { _memory_peak_Bytes = _memory_used_Bytes.load(); }
+
+void Device::set_memory_budget(uint64_t budget_Bytes, BudgetCallback callback) {
+  std::lock_guard lock(_budget_mutex);
+  _memory_budget_Bytes = budget_Bytes;
+  _budget_callback = std::move(callback);
+}
+
+uint64_t Device::memory_budget_Bytes() const { return _memory_budget_Bytes; }
+
+uint64_t Device::memory_available_Bytes() const {
+  uint64_t budget = _memory_budget_Bytes;
+  uint64_t limit = budget > 0 ? budget : memory_Bytes();
+  uint64_t used = _memory_used_Bytes;
+  return used < limit ? limit - used : 0;
+}
+
 uint64_t Device::global_cache_Bytes() const { return _cl_device.getInfo<CL_DEVICE_GLOBAL_MEM_CACHE_SIZE>(); }
 
 uint64_t Device::local_cache_Bytes() const { return _cl_device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>(); }
 
 uint64_t Device::max_global_buffer_Bytes() const { return _cl_device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(); }
 
+uint32_t Device::memory_alignment_Bytes() const {
+  // CL_DEVICE_MEM_BASE_ADDR_ALIGN is given in bits
+  return _cl_device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8;
+}
+
 uint64_t Device::max_constant_buffer_Bytes() const { return _cl_device.getInfo<CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE>(); }
 
 uint64_t Device::compute_units() const { return _cl_device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>(); }
@@ -105,6 +140,33 @@ uint64_t Device::estimated_flops() const {
 
 bool Device::intel_gt_4gb_buffer_required() const { return _intel_gt_4gb_buffer_required; }
 
+std::vector<Device*> Device::partition_by_numa() {
+  auto domains = _cl_device.getInfo<CL_DEVICE_PARTITION_AFFINITY_DOMAIN>();
+  if ((domains & CL_DEVICE_AFFINITY_DOMAIN_NUMA) == 0) {
+    throw std::runtime_error("Device '" + name() + "' can not be partitioned by NUMA node.");
+  }
+  return _partition({CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0});
+}
+
+std::vector<Device*> Device::partition_equally(uint32_t compute_units) {
+  if (compute_units == 0) {
+    throw std::runtime_error("Device '" + name() + "' can not be partitioned into sub-devices without compute units.");
+  }
+  return _partition({CL_DEVICE_PARTITION_EQUALLY, static_cast<cl_device_partition_property>(compute_units), 0});
+}
+
+Device* Device::get_parent() const { return _parent; }
+
+bool Device::is_sub_device() const { return _parent != nullptr; }
+
+std::vector<Device*> Device::_partition(const std::vector<cl_device_partition_property>& properties) {
+  auto supported = _cl_device.getInfo<CL_DEVICE_PARTITION_PROPERTIES>();
+  if (std::find(supported.begin(), supported.end(), properties[0]) == supported.end()) {
+    throw std::runtime_error("Device '" + name() + "' does not support this partition type.");
+  }
+  return DeviceManager::get_instance()._sub_devices_of(*this, properties);
+}
+
 uint64_t Device::_compute_cores() {
   auto device_name = name();
   auto device_vendor = vendor();
@@ -165,6 +227,63 @@ uint64_t Device::_compute_cores() {
   return compute_units();
 }
 
+bool Device::_try_reserve_memory(uint64_t size_Bytes) {
+  // sub-devices share the memory of their parent: allocations are charged to the parent as well
+  if (_parent != nullptr && !_parent->_try_reserve_memory(size_Bytes)) {
+    return false;
+  }
+  if (!_try_reserve_own_memory(size_Bytes)) {
+    if (_parent != nullptr) {
+      _parent->_release_memory(size_Bytes);
+    }
+    return false;
+  }
+  return true;
+}
+
+bool Device::_try_reserve_own_memory(uint64_t size_Bytes) {
+  uint64_t used = _memory_used_Bytes.load();
+  do {
+    uint64_t budget = _memory_budget_Bytes;
+    if (budget > 0 && used + size_Bytes > budget) {
+      return false;
+    }
+  } while (!_memory_used_Bytes.compare_exchange_weak(used, used + size_Bytes));
+  uint64_t peak = _memory_peak_Bytes.load();
+  while (used + size_Bytes > peak && !_memory_peak_Bytes.compare_exchange_weak(peak, used + size_Bytes)) {
+  }
+  return true;
+}
+
+void Device::_reserve_memory(uint64_t size_Bytes) {
+  if (_parent != nullptr) {
+    _parent->_reserve_memory(size_Bytes);
+  }
+  while (!_try_reserve_own_memory(size_Bytes)) {
+    BudgetCallback callback;
+    {
+      std::lock_guard lock(_budget_mutex);
+      callback = _budget_callback;
+    }
+    // the callback is called without lock, so that it can release memory or change the budget
+    if (!callback || !callback(*this, size_Bytes)) {
+      if (_parent != nullptr) {
+        _parent->_release_memory(size_Bytes);
+      }
+      throw MemoryBudgetError("Allocating " + std::to_string(size_Bytes) + " Bytes on device '" + name() +
+                              "' exceeds the memory budget of " + std::to_string(_memory_budget_Bytes) + " Bytes (" +
+                              std::to_string(_memory_used_Bytes) + " Bytes used).");
+    }
+  }
+}
+
+void Device::_release_memory(uint64_t size_Bytes) {
+  _memory_used_Bytes -= size_Bytes;
+  if (_parent != nullptr) {
+    _parent->_release_memory(size_Bytes);
+  }
+}
+
 std::ostream& operator<<(std::ostream& os, const Device& device) {
   os << device.type() << device.name() << " ("
      << device.compute_units() << " CU [" << device.cores() << " Cores])";
@@ -181,10 +300,14 @@ std::ostream& operator<<(std::ostream& os, const Device::Type& type) {
 template <>
 Device* DeviceManager::get<Filter::ID>(uint32_t value) {
   auto& dm = DeviceManager::get_instance();
-  if (value >= dm._devices.size()) {
+  if (value < dm._devices.size()) {
+    return &dm._devices[value];
+  }
+  std::lock_guard lock(dm._sub_devices_mutex);
+  if (value - dm._devices.size() >= dm._sub_devices.size()) {
     throw std::runtime_error("Device with id " + std::to_string(value) + " not available.");
   }
-  return &dm._devices[value];
+  return &dm._sub_devices[value - dm._devices.size()];
 }
 
 template <>
@@ -202,21 +325,76 @@ Device* DeviceManager::get<Filter::MIN_MEMORY>() {
                              [](const Device& a, const Device& b) { return a.memory_Bytes() < b.memory_Bytes(); }));
 }
 
+namespace {
+/// measured FLOPS if all devices have characteristics, else estimated FLOPS
+std::vector<double> device_flops(std::vector<Device>& devices) {
+  std::vector<double> flops;
+  for (auto& device : devices) {
+    auto characteristics = device.characteristics();
+    if (!characteristics) {
+      flops.clear();
+      break;
+    }
+    flops.push_back(characteristics->flops);
+  }
+  if (flops.empty()) {
+    for (auto& device : devices) {
+      flops.push_back(static_cast<double>(device.estimated_flops()));
+    }
+  }
+  return flops;
+}
+
+template <typename F>
+std::vector<double> characterized(std::vector<Device>& devices, const F& value) {
+  std::vector<double> values;
+  for (auto& device : devices) {
+    values.push_back(value(device.characterize()));
+  }
+  return values;
+}
+}  // namespace
+
 template <>
 Device* DeviceManager::get<Filter::MAX_FLOPS>() {
   auto& dm = DeviceManager::get_instance();
-
-  return &(*std::max_element(dm._devices.begin(), dm._devices.end(), [](const Device& a, const Device& b) {
-    return a.estimated_flops() < b.estimated_flops();
-  }));
+  auto flops = device_flops(dm._devices);
+  return &dm._devices[std::max_element(flops.begin(), flops.end()) - flops.begin()];
 }
 
 template <>
 Device* DeviceManager::get<Filter::MIN_FLOPS>() {
   auto& dm = DeviceManager::get_instance();
-  return &(*std::min_element(dm._devices.begin(), dm._devices.end(), [](const Device& a, const Device& b) {
-    return a.estimated_flops() < b.estimated_flops();
-  }));
+  auto flops = device_flops(dm._devices);
+  return &dm._devices[std::min_element(flops.begin(), flops.end()) - flops.begin()];
+}
+
+template <>
+Device* DeviceManager::get<Filter::MAX_MEASURED_FLOPS>() {
+  auto& dm = DeviceManager::get_instance();
+  auto flops = characterized(dm._devices, [](const Device::Characteristics& c) { return c.flops; });
+  return &dm._devices[std::max_element(flops.begin(), flops.end()) - flops.begin()];
+}
+
+template <>
+Device* DeviceManager::get<Filter::MIN_MEASURED_FLOPS>() {
+  auto& dm = DeviceManager::get_instance();
+  auto flops = characterized(dm._devices, [](const Device::Characteristics& c) { return c.flops; });
+  return &dm._devices[std::min_element(flops.begin(), flops.end()) - flops.begin()];
+}
+
+template <>
+Device* DeviceManager::get<Filter::MAX_MEASURED_BANDWIDTH>() {
+  auto& dm = DeviceManager::get_instance();
+  auto bandwidth = characterized(dm._devices, [](const Device::Characteristics& c) { return c.global_Bytes_per_s; });
+  return &dm._devices[std::max_element(bandwidth.begin(), bandwidth.end()) - bandwidth.begin()];
+}
+
+template <>
+Device* DeviceManager::get<Filter::MIN_MEASURED_BANDWIDTH>() {
+  auto& dm = DeviceManager::get_instance();
+  auto bandwidth = characterized(dm._devices, [](const Device::Characteristics& c) { return c.global_Bytes_per_s; });
+  return &dm._devices[std::min_element(bandwidth.begin(), bandwidth.end()) - bandwidth.begin()];
 }
 
 template <>
@@ -258,6 +436,28 @@ DeviceManager& DeviceManager::get_instance() {
   return device_manager;
 }
 
+std::vector<Device*> DeviceManager::_sub_devices_of(Device& parent,
+                                                    const std::vector<cl_device_partition_property>& properties) {
+  std::lock_guard lock(_sub_devices_mutex);
+  auto& sub_devices = _partitions[{parent.get_id(), properties}];
+  if (!sub_devices.empty()) {
+    return sub_devices;
+  }
+  std::vector<cl::Device> cl_sub_devices;
+  try {
+    check_opencl_error(parent.get_cl_device().createSubDevices(properties.data(), &cl_sub_devices));
+  } catch (const cl::Error& error) {
+    check_opencl_error(error.err());
+  }
+  for (auto& cl_sub_device : cl_sub_devices) {
+    auto id = static_cast<uint32_t>(_devices.size() + _sub_devices.size());
+    auto& sub_device = _sub_devices.emplace_back(id, std::move(cl_sub_device));
+    sub_device._parent = &parent;
+    sub_devices.push_back(&sub_device);
+  }
+  return sub_devices;
+}
+
 DeviceManager::DeviceManager() {
   std::vector<cl::Platform> cl_platforms;
   cl::Platform::get(&cl_platforms);
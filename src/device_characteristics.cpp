@@ -0,0 +1,289 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/device.h>
+#include <missocl/program_cache.h>
+#include <missocl/utils.h>
+
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+
+namespace mcl {
+
+namespace {
+
+constexpr unsigned fma_iterations = 512;
+constexpr unsigned local_iterations = 1024;
+constexpr unsigned repetitions = 3;
+
+/**
+ * FMA: 4 independent float4 chains per work item, 16 FMAs per iteration.
+ * local: every work item reads local memory at a different offset per iteration, conflict free within a warp.
+ * copy: float4 global memory copy.
+ */
+const char* benchmark_source = R"(
+kernel void mcl_fma(global float* out, const float a, const float b) {
+  const float id = (float)get_global_id(0);
+  float4 x = (float4)(id, id + 1.0f, id + 2.0f, id + 3.0f);
+  float4 y = x + 4.0f;
+  float4 z = x + 8.0f;
+  float4 w = x + 12.0f;
+  for (uint i = 0; i < MCL_FMA_ITERATIONS; ++i) {
+    x = fma(x, a, b);
+    y = fma(y, a, b);
+    z = fma(z, a, b);
+    w = fma(w, a, b);
+  }
+  const float4 sum = x + y + z + w;
+  out[get_global_id(0)] = sum.x + sum.y + sum.z + sum.w;
+}
+
+kernel void mcl_local(global float* out) {
+  local float tile[MCL_LOCAL_SIZE];
+  const uint lid = get_local_id(0);
+  tile[lid] = (float)lid;
+  barrier(CLK_LOCAL_MEM_FENCE);
+  float sum = 0.0f;
+  for (uint i = 0; i < MCL_LOCAL_ITERATIONS; ++i) {
+    sum += tile[(lid + i) & (MCL_LOCAL_SIZE - 1)];
+  }
+  out[get_global_id(0)] = sum;
+}
+
+kernel void mcl_copy(global const float4* in, global float4* out) {
+  out[get_global_id(0)] = in[get_global_id(0)];
+}
+)";
+
+/// returns the best (shortest) device time in seconds of repetitions runs of enqueue after one warm up run
+template <typename F>
+double best_seconds(const F& enqueue) {
+  double best = std::numeric_limits<double>::max();
+  for (unsigned i = 0; i <= repetitions; ++i) {
+    cl::Event event;
+    enqueue(event);
+    check_opencl_error(event.wait());
+    if (i == 0) {
+      continue;
+    }
+    auto ns = event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    best = std::min(best, std::max(static_cast<double>(ns), 1.0) / 1e9);
+  }
+  return best;
+}
+
+// ===== CharacteristicsFile ===========================================================================================
+/// text file of Device::Characteristics: one device per line, "<key>\t<flops> <global> <local> <write> <read>"
+class CharacteristicsFile {
+ public:
+  static CharacteristicsFile& get_instance() {
+    static CharacteristicsFile file;
+    return file;
+  }
+
+  void set_file(std::filesystem::path file) {
+    std::lock_guard lock(_mutex);
+    _file = std::move(file);
+    _entries.clear();
+    _read_done = false;
+  }
+
+  std::filesystem::path get_file() {
+    std::lock_guard lock(_mutex);
+    return _file;
+  }
+
+  std::optional<Device::Characteristics> load(const std::string& key) {
+    std::lock_guard lock(_mutex);
+    _read();
+    auto it = _entries.find(key);
+    if (it == _entries.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  void store(const std::string& key, const Device::Characteristics& characteristics) {
+    std::lock_guard lock(_mutex);
+    _read();
+    _entries[key] = characteristics;
+    _write();
+  }
+
+ private:
+  CharacteristicsFile() {
+    auto directory = default_cache_directory();
+    if (!directory.empty()) {
+      _file = directory / "devices.db";
+    }
+  }
+
+  void _read() {
+    if (_read_done) {
+      return;
+    }
+    _read_done = true;
+    _merge_file();
+  }
+
+  void _merge_file() {
+    if (_file.empty()) {
+      return;
+    }
+    read_key_value_file(_file, [this](const std::string& key, const std::string& line) {
+      Device::Characteristics c;
+      std::stringstream values(line);
+      if (values >> c.flops >> c.global_Bytes_per_s >> c.local_Bytes_per_s >> c.write_Bytes_per_s >>
+          c.read_Bytes_per_s) {
+        // entries that are already known take precedence over the file
+        _entries.emplace(key, c);
+      }
+    });
+  }
+
+  void _write() {
+    if (_file.empty()) {
+      return;
+    }
+    // another process may have characterized other devices in the meantime: keep its entries
+    _merge_file();
+    bool written = write_file_atomically(_file, [this](std::ostream& out) {
+      out.precision(std::numeric_limits<double>::max_digits10);
+      for (const auto& [key, c] : _entries) {
+        out << key << '\t' << c.flops << ' ' << c.global_Bytes_per_s << ' ' << c.local_Bytes_per_s << ' '
+            << c.write_Bytes_per_s << ' ' << c.read_Bytes_per_s << '\n';
+      }
+      return static_cast<bool>(out);
+    });
+    if (!written) {
+      std::cerr << "Could not write device characteristics '" << _file << "'." << std::endl;
+    }
+  }
+
+  std::mutex _mutex;
+  std::filesystem::path _file;
+  bool _read_done{false};
+  std::unordered_map<std::string, Device::Characteristics> _entries;
+};
+
+}  // namespace
+
+// ===== Device ========================================================================================================
+const Device::Characteristics& Device::characterize(bool force) {
+  if (!force) {
+    if (characteristics()) {
+      std::lock_guard lock(_characteristics_mutex);
+      return *_characteristics;
+    }
+  }
+  auto measured = _measure();
+  CharacteristicsFile::get_instance().store(_characteristics_key(), measured);
+  std::lock_guard lock(_characteristics_mutex);
+  _characteristics = measured;
+  return *_characteristics;
+}
+
+std::optional<Device::Characteristics> Device::characteristics() const {
+  std::lock_guard lock(_characteristics_mutex);
+  if (!_characteristics) {
+    _characteristics = CharacteristicsFile::get_instance().load(_characteristics_key());
+  }
+  return _characteristics;
+}
+
+void Device::set_characteristics_file(std::filesystem::path file) {
+  CharacteristicsFile::get_instance().set_file(std::move(file));
+}
+
+std::filesystem::path Device::get_characteristics_file() { return CharacteristicsFile::get_instance().get_file(); }
+
+std::string Device::_characteristics_key() const {
+  // sub-devices share name, vendor and driver with their parent, but not its compute units
+  std::string key = name() + '|' + vendor() + '|' + driver_version() + '|' + std::to_string(compute_units());
+  for (char& c : key) {
+    if (c == '\t' || c == '\n' || c == '\r') {
+      c = ' ';
+    }
+  }
+  return key;
+}
+
+Device::Characteristics Device::_measure() {
+  try {
+    cl::Context context(_cl_device);
+    cl::CommandQueue queue(context, _cl_device, CL_QUEUE_PROFILING_ENABLE);
+
+    // local size: power of 2, so that the local benchmark can wrap its index with a mask
+    const size_t local_size =
+        std::bit_floor(std::min<size_t>(256, _cl_device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>()));
+    const size_t global_size = std::max<uint64_t>(compute_units(), 1) * local_size * 16;
+    const std::string build_options = "-DMCL_FMA_ITERATIONS=" + std::to_string(fma_iterations) +
+                                      " -DMCL_LOCAL_ITERATIONS=" + std::to_string(local_iterations) +
+                                      " -DMCL_LOCAL_SIZE=" + std::to_string(local_size);
+    cl::Program program = ProgramCache::build(context, *this, benchmark_source, build_options);
+
+    Characteristics result;
+    cl::Buffer out(context, CL_MEM_WRITE_ONLY, global_size * sizeof(float));
+
+    cl::Kernel fma(program, "mcl_fma");
+    fma.setArg(0, out);
+    fma.setArg(1, 0.999f);
+    fma.setArg(2, 0.001f);
+    double seconds = best_seconds([&](cl::Event& event) {
+      check_opencl_error(queue.enqueueNDRangeKernel(fma, cl::NullRange, cl::NDRange(global_size),
+                                                    cl::NDRange(local_size), nullptr, &event));
+    });
+    result.flops = static_cast<double>(global_size) * fma_iterations * 16 * 2 / seconds;
+
+    cl::Kernel local(program, "mcl_local");
+    local.setArg(0, out);
+    seconds = best_seconds([&](cl::Event& event) {
+      check_opencl_error(queue.enqueueNDRangeKernel(local, cl::NullRange, cl::NDRange(global_size),
+                                                    cl::NDRange(local_size), nullptr, &event));
+    });
+    result.local_Bytes_per_s = static_cast<double>(global_size) * local_iterations * sizeof(float) / seconds;
+
+    // 64 MiB per buffer (less on small devices), large enough to not be served by the caches of current devices
+    const size_t copy_Bytes = std::min<uint64_t>({uint64_t{64} << 20, max_global_buffer_Bytes(), memory_Bytes() / 4}) /
+                              (local_size * 16) * (local_size * 16);
+    cl::Buffer in(context, CL_MEM_READ_WRITE, copy_Bytes);
+    cl::Buffer copy_out(context, CL_MEM_READ_WRITE, copy_Bytes);
+    cl::Kernel copy(program, "mcl_copy");
+    copy.setArg(0, in);
+    copy.setArg(1, copy_out);
+    seconds = best_seconds([&](cl::Event& event) {
+      check_opencl_error(queue.enqueueNDRangeKernel(copy, cl::NullRange, cl::NDRange(copy_Bytes / 16),
+                                                    cl::NDRange(local_size), nullptr, &event));
+    });
+    result.global_Bytes_per_s = 2 * static_cast<double>(copy_Bytes) / seconds;
+
+    std::vector<char> host(copy_Bytes, 1);
+    seconds = best_seconds([&](cl::Event& event) {
+      check_opencl_error(queue.enqueueWriteBuffer(in, CL_FALSE, 0, copy_Bytes, host.data(), nullptr, &event));
+    });
+    result.write_Bytes_per_s = static_cast<double>(copy_Bytes) / seconds;
+    seconds = best_seconds([&](cl::Event& event) {
+      check_opencl_error(queue.enqueueReadBuffer(in, CL_FALSE, 0, copy_Bytes, host.data(), nullptr, &event));
+    });
+    result.read_Bytes_per_s = static_cast<double>(copy_Bytes) / seconds;
+    return result;
+  } catch (const cl::Error& error) {
+    std::string message = "Characterizing device '" + name() + "' failed: " + error.what() + " (error " +
+                          std::to_string(error.err()) + ").";
+    throw OpenCLError(message.c_str());
+  }
+}
+
+}  // namespace mcl
@@ -12,9 +12,14 @@
 #include <missocl/device.h>
 #include <missocl/environment.h>
 #include <missocl/kernel.h>
+#include <missocl/program_cache.h>
+#include <missocl/thread_pool.h>
 #include <missocl/utils.h>
 
+#include <algorithm>
 #include <fstream>
+#include <iostream>
+#include <stdexcept>
 
 namespace mcl {
 
@@ -25,26 +30,323 @@ Environment::Environment(Device& device) : _device(&device) { _init(); }
 
 Environment::Environment(Device* device) : _device(device) { _init(); }
 
+Environment::Environment(Options options) : _device(DeviceManager::get<Filter::MAX_FLOPS>()), _options(options) {
+  _init();
+}
+
+Environment::Environment(Device& device, Options options) : _device(&device), _options(options) { _init(); }
+
+Environment::Environment(Device* device, Options options) : _device(device), _options(options) { _init(); }
+
+Environment::Environment(Device* device, Options options, cl::Context cl_context)
+    : _cl_context(std::move(cl_context)), _device(device), _options(options) {
+  _init();
+}
+
+Environment::~Environment() { trim_buffer_pool(); }
+
+std::vector<std::unique_ptr<Environment>> Environment::create_shared(const std::vector<Device*>& devices) {
+  return create_shared(devices, Options());
+}
+
+std::vector<std::unique_ptr<Environment>> Environment::create_shared(const std::vector<Device*>& devices,
+                                                                     Options options) {
+  if (devices.empty()) {
+    throw std::runtime_error("Environment::create_shared: no devices.");
+  }
+  // a context must not contain a device twice
+  std::vector<cl::Device> cl_devices;
+  auto platform = devices.front()->get_cl_device().getInfo<CL_DEVICE_PLATFORM>();
+  for (auto* device : devices) {
+    if (device->get_cl_device().getInfo<CL_DEVICE_PLATFORM>() != platform) {
+      throw std::runtime_error("Environment::create_shared: device '" + device->name() +
+                               "' belongs to another platform than '" + devices.front()->name() + "'.");
+    }
+    if (std::none_of(cl_devices.begin(), cl_devices.end(),
+                     [device](const cl::Device& d) { return d() == device->get_cl_device()(); })) {
+      cl_devices.push_back(device->get_cl_device());
+    }
+  }
+  cl_int error;
+  cl::Context cl_context(cl_devices, nullptr, nullptr, nullptr, &error);
+  check_opencl_error(error);
+  std::vector<std::unique_ptr<Environment>> environments;
+  for (auto* device : devices) {
+    // the constructor is private: std::make_unique can not be used
+    environments.emplace_back(new Environment(device, options, cl_context));
+  }
+  return environments;
+}
+
+bool Environment::shares_context(const Environment& other) const { return _cl_context() == other._cl_context(); }
+
+const cl::Context& Environment::get_cl_context() const { return _cl_context; }
+
 Kernel Environment::add_kernel(cl::NDRange range, std::string name, const std::string& cl_c_source) {
-  return {*this, range, std::move(name), cl_c_source};
+  return {*this, range, std::move(name), get_program(cl_c_source), cl_c_source};
 }
 
 Kernel Environment::add_kernel(cl::NDRange range, std::string name, const std::filesystem::path& cl_c_source_file) {
-  std::ifstream file(cl_c_source_file);
-  if (!file) {
-    std::cerr << "Could not read file '" << cl_c_source_file << "'." << std::endl;
+  return add_kernel(range, std::move(name), _read_source_file(cl_c_source_file));
+}
+
+std::future<Kernel> Environment::add_kernel_async(cl::NDRange range, std::string name, std::string cl_c_source) {
+  return ThreadPool::global().submit(
+      [this, range, name = std::move(name), cl_c_source = std::move(cl_c_source)]() mutable -> Kernel {
+        return add_kernel(range, std::move(name), cl_c_source);
+      });
+}
+
+std::future<Kernel> Environment::add_kernel_async(cl::NDRange range, std::string name,
+                                                  std::filesystem::path cl_c_source_file) {
+  return ThreadPool::global().submit(
+      [this, range, name = std::move(name), cl_c_source_file = std::move(cl_c_source_file)]() mutable -> Kernel {
+        return add_kernel(range, std::move(name), cl_c_source_file);
+      });
+}
+
+std::vector<Kernel> Environment::add_kernels(cl::NDRange range, const std::string& cl_c_source) {
+  const auto& cl_program = get_program(cl_c_source);
+  std::vector<Kernel> kernels;
+  for (auto& name : kernel_names(cl_c_source)) {
+    kernels.push_back({*this, range, std::move(name), cl_program, cl_c_source});
+  }
+  return kernels;
+}
+
+std::vector<Kernel> Environment::add_kernels(cl::NDRange range, const std::filesystem::path& cl_c_source_file) {
+  return add_kernels(range, _read_source_file(cl_c_source_file));
+}
+
+std::vector<std::string> Environment::kernel_names(const std::string& cl_c_source) {
+  // CL_PROGRAM_KERNEL_NAMES is a semicolon separated list of kernel names
+  std::string names = get_program(cl_c_source).getInfo<CL_PROGRAM_KERNEL_NAMES>();
+  std::vector<std::string> result;
+  size_t begin = 0;
+  while (begin < names.size()) {
+    size_t end = names.find(';', begin);
+    if (end == std::string::npos) {
+      end = names.size();
+    }
+    if (end > begin) {
+      result.push_back(names.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return result;
+}
+
+std::vector<std::string> Environment::kernel_names(const std::filesystem::path& cl_c_source_file) {
+  return kernel_names(_read_source_file(cl_c_source_file));
+}
+
+const cl::Program& Environment::get_program(const std::string& cl_c_source) {
+  std::string build_options = _build_options();
+  std::string key = build_options + '\0' + cl_c_source;
+  std::promise<cl::Program> cl_program;
+  std::shared_future<cl::Program> built;
+  bool cl_program_building = false;
+  {
+    std::lock_guard lock(_programs_mutex);
+    auto it = _programs.find(key);
+    if (it != _programs.end()) {
+      built = it->second;
+    } else {
+      built = cl_program.get_future().share();
+      _programs.emplace(key, built);
+      cl_program_building = true;
+    }
+  }
+  if (!cl_program_building) {
+    // the shared state is kept alive by _programs, so the returned reference stays valid
+    return built.get();
+  }
+  // build outside of the lock, so that different sources are built concurrently
+  try {
+    cl_program.set_value(
+        ProgramCache::build(_cl_context, *_device, _device_capabilities + cl_c_source, build_options));
+  } catch (...) {
+    cl_program.set_exception(std::current_exception());
+    // allow a later retry instead of caching the failure
+    std::lock_guard lock(_programs_mutex);
+    _programs.erase(key);
   }
-  return {*this, range, std::move(name), {std::istreambuf_iterator<char>(file), (std::istreambuf_iterator<char>())}};
+  return built.get();
 }
 
 const Device* Environment::get_device() const { return _device; }
 
+unsigned Environment::queue_count() const { return _cl_queues.size(); }
+
+cl::CommandQueue& Environment::get_cl_queue(unsigned queue_index) {
+  return _cl_queues[_checked_queue_index(queue_index)];
+}
+
+bool Environment::out_of_order() const { return _options.out_of_order; }
+
+bool Environment::profiling() const { return _options.profiling; }
+
+Profiler& Environment::get_profiler() { return _profiler; }
+
+bool Environment::buffer_pool() const { return _options.buffer_pool; }
+
+BufferPool::Statistics Environment::buffer_pool_statistics() const { return _buffer_pool.statistics(); }
+
+void Environment::trim_buffer_pool() { _release_memory(_buffer_pool.trim()); }
+
+uint64_t Environment::memory_used_Bytes() const { return _memory_used_Bytes; }
+
+uint64_t Environment::memory_peak_Bytes() const { return _memory_peak_Bytes; }
+
+void Environment::flush() {
+  for (auto& cl_queue : _cl_queues) {
+    check_opencl_error(cl_queue.flush());
+  }
+}
+
+void Environment::finish() {
+  for (auto& cl_queue : _cl_queues) {
+    check_opencl_error(cl_queue.finish());
+  }
+}
+
 void Environment::_init() {
   cl_int error;
-  _cl_context = cl::Context(_device->get_cl_device(), nullptr, nullptr, nullptr, &error);
-  check_opencl_error(error);
-  _cl_queue = cl::CommandQueue(_cl_context, _device->get_cl_device(), 0, &error);
+  if (_cl_context() == nullptr) {
+    _cl_context = cl::Context(_device->get_cl_device(), nullptr, nullptr, nullptr, &error);
+    check_opencl_error(error);
+  }
+  if (_options.queue_count == 0) {
+    _options.queue_count = 1;
+  }
+  cl_command_queue_properties properties = _options.profiling ? CL_QUEUE_PROFILING_ENABLE : 0;
+  if (_options.out_of_order) {
+    if (_device->get_cl_device().getInfo<CL_DEVICE_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+      properties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+    } else {
+      std::cerr << "Device '" << _device->name() << "' does not support out-of-order queues, using in-order queues."
+                << std::endl;
+      _options.out_of_order = false;
+    }
+  }
+  _cl_queues.reserve(_options.queue_count);
+  for (unsigned i = 0; i < _options.queue_count; ++i) {
+    _cl_queues.emplace_back(_cl_context, _device->get_cl_device(), properties, &error);
+    check_opencl_error(error);
+  }
+  if (_options.buffer_pool && (_cl_queues.size() > 1 || _options.out_of_order)) {
+    // released buffers are handed out again at once: only a single in-order queue orders their old and new commands
+    std::cerr << "Buffer pooling requires a single in-order queue, buffers are not pooled." << std::endl;
+    _options.buffer_pool = false;
+  }
+}
+
+unsigned Environment::_checked_queue_index(unsigned queue_index) const {
+  if (queue_index >= _cl_queues.size()) {
+    throw std::runtime_error("Queue with index " + std::to_string(queue_index) + " not available (" +
+                             std::to_string(_cl_queues.size()) + " queues).");
+  }
+  return queue_index;
+}
+
+cl::Buffer Environment::_allocate_buffer(size_t size_Bytes, cl_mem_flags flags, void* host_ptr, bool device_memory) {
+  if (_device->intel_gt_4gb_buffer_required()) {
+    // https://github.com/intel/compute-runtime/blob/master/programmers-guide/ALLOCATIONS_GREATER_THAN_4GB.md
+    flags |= ((int)1 << 23);
+  }
+  if (_pooled(flags, host_ptr)) {
+    cl::Buffer buffer = _buffer_pool.acquire(size_Bytes, flags);
+    if (buffer() != nullptr) {
+      return buffer;
+    }
+    size_t allocated_Bytes = BufferPool::size_class(size_Bytes);
+    _reserve_memory(allocated_Bytes);
+    try {
+      return _buffer_pool.allocate(_cl_context, size_Bytes, flags);
+    } catch (...) {
+      _release_memory(allocated_Bytes);
+      throw;
+    }
+  }
+  if (device_memory) {
+    _reserve_memory(size_Bytes);
+  }
+  int error = 0;
+  cl::Buffer buffer;
+  try {
+    // throws cl::Error on failure (CL_HPP_ENABLE_EXCEPTIONS)
+    buffer = cl::Buffer(_cl_context, flags, size_Bytes, host_ptr, &error);
+  } catch (...) {
+    if (device_memory) {
+      _release_memory(size_Bytes);
+    }
+    throw;
+  }
+  if (error != CL_SUCCESS && device_memory) {
+    _release_memory(size_Bytes);
+  }
   check_opencl_error(error);
+  return buffer;
+}
+
+void Environment::_release_buffer(cl::Buffer& buffer, size_t size_Bytes, cl_mem_flags flags, void* host_ptr,
+                                  bool device_memory) {
+  if (_device->intel_gt_4gb_buffer_required()) {
+    flags |= ((int)1 << 23);
+  }
+  if (_pooled(flags, host_ptr)) {
+    // the pool keeps the buffer allocated: it stays counted as used device memory
+    _buffer_pool.release(std::move(buffer), size_Bytes, flags);
+  } else if (device_memory) {
+    _release_memory(size_Bytes);
+  }
+  buffer = cl::Buffer();
+}
+
+void Environment::_reserve_memory(uint64_t size_Bytes) {
+  if (!_device->_try_reserve_memory(size_Bytes)) {
+    // cached buffers are the first to go
+    trim_buffer_pool();
+    _device->_reserve_memory(size_Bytes);
+  }
+  uint64_t used = _memory_used_Bytes += size_Bytes;
+  uint64_t peak = _memory_peak_Bytes.load();
+  while (used > peak && !_memory_peak_Bytes.compare_exchange_weak(peak, used)) {
+  }
+}
+
+void Environment::_release_memory(uint64_t size_Bytes) {
+  _device->_release_memory(size_Bytes);
+  _memory_used_Bytes -= size_Bytes;
+}
+
+bool Environment::_pooled(cl_mem_flags flags, void* host_ptr) const {
+  // buffers that use host memory are tied to their host allocation
+  return _options.buffer_pool && host_ptr == nullptr &&
+         (flags & (CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR)) == 0;
+}
+
+std::string Environment::_build_options() const {
+  std::string build_options("-cl-fast-relaxed-math");
+  // std::string build_options("-cl-std=CL1.2");
+  if (_device->intel_gt_4gb_buffer_required()) {
+    build_options.append(" -cl-intel-greater-than-4GB-buffer-required");
+  }
+  return build_options;
+}
+
+std::string Environment::_read_source_file(const std::filesystem::path& cl_c_source_file) {
+  std::ifstream file(cl_c_source_file);
+  if (!file) {
+    std::cerr << "Could not read file '" << cl_c_source_file << "'." << std::endl;
+  }
+  return {std::istreambuf_iterator<char>(file), (std::istreambuf_iterator<char>())};
+}
+
+void Environment::_record(Profiler::Record record, const cl::Event& event) {
+  if (_options.profiling) {
+    _profiler.record(std::move(record), event);
+  }
 }
 
-}  // namespace mcl
\ No newline at end of file
+}  // namespace mcl
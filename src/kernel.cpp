@@ -10,45 +10,359 @@
  */
 
 #include <missocl/opencl.h>
+#include <missocl/tuning.h>
 #include <missocl/utils.h>
 
+#include <algorithm>
+#include <limits>
+#include <regex>
+#include <set>
+#include <stdexcept>
+
 namespace mcl {
 
+namespace {
+cl::NDRange to_ndrange(const std::vector<cl::size_type>& range) {
+  switch (range.size()) {
+    case 1:
+      return {range[0]};
+    case 2:
+      return {range[0], range[1]};
+    case 3:
+      return {range[0], range[1], range[2]};
+    default:
+      return cl::NullRange;
+  }
+}
+
+/**
+ * Returns global_range rounded up to a multiple of local_range in every dimension.
+ */
+cl::NDRange padded_global_range(const cl::NDRange& global_range, const cl::NDRange& local_range) {
+  const cl::size_type* global = global_range;
+  const cl::size_type* local = local_range;
+  std::vector<cl::size_type> padded(global, global + global_range.dimensions());
+  for (cl::size_type dim = 0; dim < padded.size() && dim < local_range.dimensions(); ++dim) {
+    if (local[dim] > 0) {
+      padded[dim] = (padded[dim] + local[dim] - 1) / local[dim] * local[dim];
+    }
+  }
+  return to_ndrange(padded);
+}
+
+/**
+ * Returns true if the parameter list of kernel name in cl_c_source contains MCL_RANGE_PARAMETERS.
+ */
+bool declares_range_parameters(const std::string& cl_c_source, const std::string& name) {
+  if (cl_c_source.find("MCL_RANGE_PARAMETERS") == std::string::npos) {
+    return false;
+  }
+  // matches "__kernel void name(", "kernel void name(" and kernels with __attribute__((...)) qualifiers
+  const std::regex kernel_declaration("kernel\\b[^;{}]*\\bvoid\\s+" + name + "\\s*\\(");
+  std::smatch match;
+  if (!std::regex_search(cl_c_source, match, kernel_declaration)) {
+    return false;
+  }
+  auto parameters_begin = static_cast<size_t>(match.position(0) + match.length(0));
+  auto parameters_end = cl_c_source.find('{', parameters_begin);
+  return cl_c_source.substr(parameters_begin, parameters_end - parameters_begin).find("MCL_RANGE_PARAMETERS") !=
+         std::string::npos;
+}
+
+/**
+ * Returns all local ranges that fit the kernel and device limits and divide global range (or any local range if padding
+ * is set). The number of work items of every local range is a multiple of preferred_multiple. Sizes are powers of two,
+ * for 1D ranges also all multiples of preferred_multiple. The empty range stands for cl::NullRange.
+ */
+std::vector<std::vector<cl::size_type>> local_range_candidates(const cl::NDRange& global_range,
+                                                               cl::size_type max_work_group_size,
+                                                               cl::size_type preferred_multiple,
+                                                               const std::vector<cl::size_type>& max_work_item_sizes,
+                                                               bool padding) {
+  const cl::size_type dimensions = global_range.dimensions();
+  const cl::size_type* global = global_range;
+  preferred_multiple = std::max<cl::size_type>(preferred_multiple, 1);
+  auto fits = [&](cl::size_type dimension, cl::size_type size) {
+    return size <= max_work_item_sizes.at(dimension) && (padding || global[dimension] % size == 0);
+  };
+  std::vector<cl::size_type> sizes;
+  for (cl::size_type size = 1; size <= max_work_group_size; size *= 2) {
+    sizes.push_back(size);
+  }
+
+  std::vector<std::vector<cl::size_type>> candidates{{}};
+  if (dimensions == 1) {
+    std::set<cl::size_type> sizes_1d;
+    for (auto size : sizes) {
+      if (size % preferred_multiple == 0) {
+        sizes_1d.insert(size);
+      }
+    }
+    // a preferred multiple of 1 would add every size up to max_work_group_size
+    if (preferred_multiple > 1) {
+      for (cl::size_type size = preferred_multiple; size <= max_work_group_size; size += preferred_multiple) {
+        sizes_1d.insert(size);
+      }
+    }
+    for (auto x : sizes_1d) {
+      if (fits(0, x)) {
+        candidates.push_back({x});
+      }
+    }
+  } else if (dimensions == 2) {
+    for (auto x : sizes) {
+      for (auto y : sizes) {
+        if (x * y <= max_work_group_size && (x * y) % preferred_multiple == 0 && fits(0, x) && fits(1, y)) {
+          candidates.push_back({x, y});
+        }
+      }
+    }
+  } else if (dimensions == 3) {
+    // the third dimension is usually small, limiting it keeps the number of candidates reasonable
+    for (auto x : sizes) {
+      for (auto y : sizes) {
+        for (cl::size_type z = 1; z <= 4; z *= 2) {
+          if (x * y * z <= max_work_group_size && (x * y * z) % preferred_multiple == 0 && fits(0, x) &&
+              fits(1, y) && fits(2, z)) {
+            candidates.push_back({x, y, z});
+          }
+        }
+      }
+    }
+  }
+  return candidates;
+}
+}  // namespace
+
 // ===== Kernel ========================================================================================================
-Kernel::Kernel(mcl::Environment& environment, cl::NDRange range, std::string name, const std::string& cl_c_source)
-    : _name(std::move(name)), _environment(&environment) {
-  set_range(range);
-  const std::string source_code(_device_capabilities + cl_c_source);
-  cl::Program::Sources sources;
-  sources.push_back(source_code);
-  cl::Program cl_program(_environment->_cl_context, sources);
-  std::string build_options("-cl-fast-relaxed-math");
-  // std::string build_options("-cl-std=CL1.2");
-  if (_environment->_device->intel_gt_4gb_buffer_required()) {
-    build_options.append(" -cl-intel-greater-than-4GB-buffer-required");
-  }
-  int error = cl_program.build(_environment->_device->get_cl_device(), build_options.c_str());
-  check_opencl_error(error);
+Kernel::Kernel(mcl::Environment& environment, cl::NDRange range, std::string name, const cl::Program& cl_program,
+               const std::string& cl_c_source)
+    : _name(std::move(name)), _program_hash(fnv1a_64(cl_c_source)), _environment(&environment) {
+  int error = CL_SUCCESS;
   _cl_kernel = cl::Kernel(cl_program, _name.c_str(), &error);
   check_opencl_error(error);
+  // kernel argument info is not available for programs loaded from binaries, so the source is inspected instead
+  _range_parameters = declares_range_parameters(cl_c_source, _name);
+  _argument_count = _cl_kernel.getInfo<CL_KERNEL_NUM_ARGS>() - (_range_parameters ? 3 : 0);
+  set_range(range);
 }
 
 void Kernel::set_range(cl::size_type x, cl::size_type y, cl::size_type z) {
-  _cl_global_range = cl::NDRange(x, y, z);
-  _cl_local_range = cl::NDRange(WORKGROUP_SIZE);
+  if (z > 0) {
+    _cl_global_range = cl::NDRange(x, y, z);
+  } else if (y > 0) {
+    _cl_global_range = cl::NDRange(x, y);
+  } else {
+    _cl_global_range = cl::NDRange(x);
+  }
+  _cl_local_range = _default_local_range();
+  _update_ranges();
+}
+
+void Kernel::set_range(cl::NDRange global) {
+  _cl_global_range = global;
+  _cl_local_range = _default_local_range();
+  _update_ranges();
 }
 
 void Kernel::set_range(cl::NDRange global, cl::NDRange local) {
   _cl_global_range = global;
   _cl_local_range = local;
+  _update_ranges();
 }
 
+const cl::NDRange& Kernel::get_global_range() const { return _cl_global_range; }
+
+const cl::NDRange& Kernel::get_local_range() const { return _cl_local_range; }
+
+const cl::NDRange& Kernel::get_enqueued_global_range() const { return _cl_enqueued_global_range; }
+
+bool Kernel::has_range_parameters() const { return _range_parameters; }
+
+void Kernel::_update_ranges() {
+  if (!_range_parameters) {
+    _cl_enqueued_global_range = _cl_global_range;
+    return;
+  }
+  _cl_enqueued_global_range = padded_global_range(_cl_global_range, _cl_local_range);
+  cl_uint first = _cl_kernel.getInfo<CL_KERNEL_NUM_ARGS>() - 3;
+  const cl::size_type* global = _cl_global_range;
+  for (cl_uint dim = 0; dim < 3; ++dim) {
+    // unused dimensions have size 1, so that MCL_RANGE_GUARD passes for get_global_id(dim) == 0
+    cl_ulong size = dim < _cl_global_range.dimensions() ? global[dim] : 1;
+    check_opencl_error(_cl_kernel.setArg(first + dim, size));
+  }
+}
+
+
+std::string Kernel::_tuning_key() const {
+  return TuningDatabase::make_key(_environment->_device->name(), _environment->_device->driver_version(), _name,
+                                  _program_hash, _cl_global_range);
+}
+
+cl::NDRange Kernel::_default_local_range() const {
+  if (auto local_range = TuningDatabase::load(_tuning_key())) {
+    return to_ndrange(*local_range);
+  }
+  // WORKGROUP_SIZE work items with as many dimensions as the global range
+  const cl::size_type dimensions = _cl_global_range.dimensions();
+  cl::NDRange local_range = cl::NullRange;
+  if (dimensions == 1) {
+    local_range = cl::NDRange(WORKGROUP_SIZE);
+  } else if (dimensions == 2) {
+    local_range = cl::NDRange(8, 8);
+  } else if (dimensions == 3) {
+    local_range = cl::NDRange(4, 4, 4);
+  }
+  if (_range_parameters) {
+    return local_range;
+  }
+  const cl::size_type* global = _cl_global_range;
+  const cl::size_type* local = local_range;
+  for (cl::size_type dim = 0; dim < local_range.dimensions(); ++dim) {
+    if (global[dim] % local[dim] != 0) {
+      return cl::NullRange;
+    }
+  }
+  return local_range;
+}
+
+cl_uint Kernel::argument_count() const { return _argument_count; }
+
+void Kernel::_begin_arguments(size_t count) {
+  if (_parameter_count == _argument_count) {
+    _parameter_count = 0;
+  }
+  if (count > _argument_count - _parameter_count) {
+    throw std::out_of_range("Kernel " + _name + ": " + std::to_string(count) + " arguments passed at index " +
+                            std::to_string(_parameter_count) + ", but the kernel takes " +
+                            std::to_string(_argument_count) + " arguments.");
+  }
+}
+
+cl_uint Kernel::_next_argument() { return _parameter_count++; }
+
+void Kernel::set_queue(unsigned queue_index) { _queue_index = _environment->_checked_queue_index(queue_index); }
+
+unsigned Kernel::get_queue() const { return _queue_index; }
+
+cl::NDRange Kernel::autotune(unsigned repetitions, bool force) {
+  const auto& cl_device = _environment->_device->get_cl_device();
+  const std::string key = _tuning_key();
+  if (!force) {
+    if (auto local_range = TuningDatabase::load(key)) {
+      _cl_local_range = to_ndrange(*local_range);
+      _update_ranges();
+      return _cl_local_range;
+    }
+  }
+  auto candidates = local_range_candidates(
+      _cl_global_range, _cl_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(cl_device),
+      _cl_kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(cl_device),
+      cl_device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>(), _range_parameters);
+  auto& cl_queue = _environment->_cl_queues[_queue_index];
+  std::vector<cl::size_type> best;
+  double best_duration = std::numeric_limits<double>::max();
+  for (const auto& candidate : candidates) {
+    cl::NDRange local_range = to_ndrange(candidate);
+    cl::NDRange global_range =
+        _range_parameters ? padded_global_range(_cl_global_range, local_range) : _cl_global_range;
+    try {
+      // the first run is a warm up
+      check_opencl_error(cl_queue.enqueueNDRangeKernel(_cl_kernel, cl::NullRange, global_range, local_range));
+      check_opencl_error(cl_queue.finish());
+      Timer timer;
+      timer.start();
+      for (unsigned i = 0; i < repetitions; ++i) {
+        check_opencl_error(cl_queue.enqueueNDRangeKernel(_cl_kernel, cl::NullRange, global_range, local_range));
+      }
+      check_opencl_error(cl_queue.finish());
+      double duration = timer.stop().count();
+      if (duration < best_duration) {
+        best_duration = duration;
+        best = candidate;
+      }
+    } catch (const cl::Error&) {
+      // candidate is not supported (e.g. CL_OUT_OF_RESOURCES because of register or local memory pressure)
+    } catch (const OpenCLError&) {
+    }
+  }
+  TuningDatabase::store(key, best);
+  _cl_local_range = to_ndrange(best);
+  _update_ranges();
+  return _cl_local_range;
+}
+
+void Kernel::set_work_per_run(uint64_t flops, uint64_t bytes) {
+  _flops_per_run = flops;
+  _bytes_per_run = bytes;
+}
+
+const std::string& Kernel::get_name() const { return _name; }
+
+void Kernel::_bind_memory(cl_uint index, MemoryObject* memory) {
+  if (memory == nullptr && index >= _bound_memory.size()) {
+    return;
+  }
+  if (index >= _bound_memory.size()) {
+    _bound_memory.resize(index + 1, nullptr);
+  }
+  _bound_memory[index] = memory;
+}
 
 void Kernel::enqueue_run(unsigned int t, const std::vector<cl::Event>* event_waitlist, cl::Event* event_returned) {
+  const bool profiling = _environment->profiling();
+  // coherent Memory: modified host data is transferred first, the launches wait for the transfers
+  bool coherent = false;
+  std::vector<cl::Event> coherent_waitlist;
+  for (auto* memory : _bound_memory) {
+    if (memory != nullptr && memory->coherent()) {
+      if (!coherent && event_waitlist != nullptr) {
+        coherent_waitlist = *event_waitlist;
+      }
+      coherent = true;
+      memory->_acquire_for_device(coherent_waitlist);
+    }
+  }
+  if (coherent) {
+    event_waitlist = &coherent_waitlist;
+  }
+  // an out-of-order queue does not order the launches: every launch waits for the previous one, so that the runs do
+  // not overlap and the event of the last launch covers all of them
+  const bool chained = t > 1 && _environment->out_of_order();
+  std::vector<cl::Event> previous;
+  cl::Event event;
   for (unsigned i = 0; i < t; ++i) {
-    int error = _environment->_cl_queue.enqueueNDRangeKernel(_cl_kernel, cl::NullRange, _cl_global_range,
-                                                             _cl_local_range, event_waitlist, event_returned);
+    const auto* waitlist = i > 0 && chained ? &previous : event_waitlist;
+    int error = _environment->_cl_queues[_queue_index].enqueueNDRangeKernel(
+        _cl_kernel, cl::NullRange, _cl_enqueued_global_range, _cl_local_range, waitlist,
+        profiling || coherent || chained || event_returned != nullptr ? &event : nullptr);
     check_opencl_error(error);
+    if (chained) {
+      previous.assign(1, event);
+    }
+    if (profiling) {
+      const cl::size_type* global = _cl_enqueued_global_range;
+      const cl::size_type* local = _cl_local_range;
+      _environment->_record({.command = Profiler::Command::KERNEL,
+                             .name = _name,
+                             .queue_index = _queue_index,
+                             .bytes = _bytes_per_run,
+                             .flops = _flops_per_run,
+                             .global_range = {global, global + _cl_enqueued_global_range.dimensions()},
+                             .local_range = {local, local + _cl_local_range.dimensions()}},
+                            event);
+    }
+    if (event_returned != nullptr) {
+      *event_returned = event;
+    }
+  }
+  if (coherent && t > 0) {
+    for (auto* memory : _bound_memory) {
+      if (memory != nullptr && memory->coherent()) {
+        memory->_release_from_device(event);
+      }
+    }
   }
 }
 
@@ -57,6 +371,6 @@ void Kernel::run(unsigned int t, const std::vector<cl::Event>* event_waitlist, c
   finish_queue();
 }
 
-void Kernel::finish_queue() { _environment->_cl_queue.finish(); }
+void Kernel::finish_queue() { _environment->_cl_queues[_queue_index].finish(); }
 
 }  // namespace mcl
\ No newline at end of file
@@ -0,0 +1,234 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/device.h>
+#include <missocl/environment.h>
+#include <missocl/kernel.h>
+#include <missocl/launch_batch.h>
+#include <missocl/memory.h>
+#include <missocl/utils.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace mcl {
+
+// ===== LaunchBatch ===================================================================================================
+LaunchBatch::LaunchBatch(Environment& environment) : _environment(&environment) {}
+
+LaunchBatch::~LaunchBatch() { _release_counters(); }
+
+void LaunchBatch::add(Kernel& kernel, unsigned count) {
+  if (count > 0) {
+    _launches.push_back(_prepare(kernel, count));
+  }
+}
+
+void LaunchBatch::add_persistent(Kernel& kernel, cl_uint argument_index, uint32_t work_items) {
+  auto launch = _prepare(kernel, 1);
+  launch.persistent = true;
+  launch.argument_index = argument_index;
+  launch.work_items = work_items;
+  launch.counter = _environment->_allocate_buffer(sizeof(cl_uint), CL_MEM_READ_WRITE, nullptr, true);
+  _launches.push_back(std::move(launch));
+}
+
+void LaunchBatch::enqueue(const std::vector<cl::Event>* event_waitlist, cl::Event* event_returned) {
+  const bool profiling = _environment->profiling();
+  // coherent Memory: modified host data is transferred first, the launches wait for the transfers
+  bool coherent = false;
+  _waitlist.clear();
+  if (event_waitlist != nullptr) {
+    _waitlist = *event_waitlist;
+  }
+  for (const auto& launch : _launches) {
+    for (auto* memory : launch.kernel->_bound_memory) {
+      if (memory != nullptr && memory->coherent()) {
+        coherent = true;
+        memory->_acquire_for_device(_waitlist);
+      }
+    }
+  }
+
+  // an out-of-order queue does not order the commands: every command waits for the previous command on its queue,
+  // also across enqueue() calls (e.g. the counter reset for the persistent launch of the previous enqueue())
+  const bool out_of_order = _environment->out_of_order();
+  _queue_events.resize(_queues.size());
+  // the first launch on every queue waits for _waitlist
+  std::vector<bool> waited(_queues.size(), false);
+  std::vector<cl::Event> last_events(_queues.size());
+  cl_int error = CL_SUCCESS;
+  for (size_t l = 0; l < _launches.size(); ++l) {
+    auto& launch = _launches[l];
+    const size_t queue = std::find(_queues.begin(), _queues.end(), launch.queue_handle) - _queues.begin();
+    cl::Event reset;
+    if (launch.persistent) {
+      cl_mem counter = launch.counter();
+      check_opencl_error(clSetKernelArg(launch.kernel_handle, launch.argument_index, sizeof(cl_mem), &counter));
+      check_opencl_error(
+          clSetKernelArg(launch.kernel_handle, launch.argument_index + 1, sizeof(cl_uint), &launch.work_items));
+      _launch_waitlist.clear();
+      if (out_of_order && _queue_events[queue]() != nullptr) {
+        _launch_waitlist.push_back(_queue_events[queue]);
+      }
+      check_opencl_error(_environment->_cl_queues[launch.queue_index].enqueueFillBuffer(
+          launch.counter, cl_uint{0}, 0, sizeof(cl_uint), _launch_waitlist.empty() ? nullptr : &_launch_waitlist,
+          &reset));
+    }
+    for (unsigned i = 0; i < launch.count; ++i) {
+      _launch_waitlist.clear();
+      if (!waited[queue]) {
+        _launch_waitlist.insert(_launch_waitlist.end(), _waitlist.begin(), _waitlist.end());
+      }
+      waited[queue] = true;
+      if (launch.persistent) {
+        // also waited for if the queue is in-order: the reset may have been enqueued before _waitlist completed
+        _launch_waitlist.push_back(reset);
+      } else if (out_of_order && _queue_events[queue]() != nullptr) {
+        _launch_waitlist.push_back(_queue_events[queue]);
+      }
+      const bool last = l + 1 == _launches.size() && i + 1 == launch.count;
+      const bool with_event = profiling || coherent || out_of_order || (last && event_returned != nullptr);
+      cl_event event = nullptr;
+      // cl::Event has the layout of cl_event, as assumed by the C++ bindings themselves
+      cl_int launch_error = clEnqueueNDRangeKernel(
+          launch.queue_handle, launch.kernel_handle, launch.dimensions, nullptr, launch.global.data(),
+          launch.has_local ? launch.local.data() : nullptr, _launch_waitlist.size(),
+          _launch_waitlist.empty() ? nullptr : reinterpret_cast<const cl_event*>(_launch_waitlist.data()),
+          with_event ? &event : nullptr);
+      if (launch_error != CL_SUCCESS) {
+        error = error == CL_SUCCESS ? launch_error : error;
+        continue;
+      }
+      if (!with_event) {
+        continue;
+      }
+      // takes ownership of event
+      last_events[queue] = cl::Event(event);
+      if (out_of_order) {
+        _queue_events[queue] = last_events[queue];
+      }
+      if (profiling) {
+        _environment->_record({.command = Profiler::Command::KERNEL,
+                               .name = launch.kernel->_name,
+                               .queue_index = launch.queue_index,
+                               .bytes = launch.kernel->_bytes_per_run,
+                               .flops = launch.kernel->_flops_per_run,
+                               .global_range = {launch.global.begin(), launch.global.begin() + launch.dimensions},
+                               .local_range = {launch.local.begin(),
+                                               launch.local.begin() + (launch.has_local ? launch.dimensions : 0)}},
+                              last_events[queue]);
+      }
+      if (last && event_returned != nullptr) {
+        *event_returned = last_events[queue];
+      }
+    }
+  }
+  for (auto* queue : _queues) {
+    clFlush(queue);
+  }
+  check_opencl_error(error);
+  if (coherent) {
+    for (const auto& launch : _launches) {
+      const size_t queue = std::find(_queues.begin(), _queues.end(), launch.queue_handle) - _queues.begin();
+      for (auto* memory : launch.kernel->_bound_memory) {
+        if (memory != nullptr && memory->coherent()) {
+          memory->_release_from_device(last_events[queue]);
+        }
+      }
+    }
+  }
+}
+
+void LaunchBatch::run(const std::vector<cl::Event>* event_waitlist) {
+  enqueue(event_waitlist);
+  for (auto* queue : _queues) {
+    check_opencl_error(clFinish(queue));
+  }
+}
+
+size_t LaunchBatch::size() const {
+  size_t launches = 0;
+  for (const auto& launch : _launches) {
+    launches += launch.count;
+  }
+  return launches;
+}
+
+void LaunchBatch::clear() {
+  _release_counters();
+  _launches.clear();
+  _queues.clear();
+  _queue_events.clear();
+}
+
+LaunchBatch::Launch LaunchBatch::_prepare(Kernel& kernel, unsigned count) {
+  if (kernel._environment != _environment) {
+    throw std::runtime_error("LaunchBatch: kernel " + kernel.get_name() + " belongs to another Environment.");
+  }
+  Launch launch{.kernel = &kernel,
+                .kernel_handle = kernel._cl_kernel(),
+                .queue_index = kernel.get_queue(),
+                .queue_handle = _environment->_cl_queues[kernel.get_queue()](),
+                .dimensions = static_cast<cl_uint>(kernel._cl_enqueued_global_range.dimensions()),
+                .global = {1, 1, 1},
+                .local = {1, 1, 1},
+                .has_local = kernel._cl_local_range.dimensions() > 0,
+                .count = count};
+  const cl::size_type* global = kernel._cl_enqueued_global_range;
+  const cl::size_type* local = kernel._cl_local_range;
+  if (launch.has_local && kernel._cl_local_range.dimensions() != launch.dimensions) {
+    throw std::runtime_error("LaunchBatch: global and local range of kernel " + kernel.get_name() +
+                             " have different dimensions.");
+  }
+  const auto& cl_device = _environment->get_device()->get_cl_device();
+  const auto max_work_item_sizes = cl_device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+  size_t work_group_size = 1;
+  for (cl_uint dim = 0; dim < launch.dimensions; ++dim) {
+    launch.global[dim] = global[dim];
+    if (!launch.has_local) {
+      continue;
+    }
+    launch.local[dim] = local[dim];
+    work_group_size *= local[dim];
+    if (local[dim] == 0 || global[dim] % local[dim] != 0 || local[dim] > max_work_item_sizes.at(dim)) {
+      throw std::runtime_error("LaunchBatch: the local range of kernel " + kernel.get_name() +
+                               " does not fit its global range or the device.");
+    }
+  }
+  if (work_group_size > kernel._cl_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(cl_device)) {
+    throw std::runtime_error("LaunchBatch: the work group of kernel " + kernel.get_name() + " is too large.");
+  }
+  if (std::find(_queues.begin(), _queues.end(), launch.queue_handle) == _queues.end()) {
+    _queues.push_back(launch.queue_handle);
+  }
+  return launch;
+}
+
+void LaunchBatch::_release_counters() {
+  const bool persistent =
+      std::any_of(_launches.begin(), _launches.end(), [](const Launch& launch) { return launch.persistent; });
+  if (!persistent) {
+    return;
+  }
+  // enqueued persistent launches may still increment their counters: a released counter could be handed out by the
+  // BufferPool while it is in use. Errors are ignored, this is called by the destructor
+  for (auto* queue : _queues) {
+    clFinish(queue);
+  }
+  for (auto& launch : _launches) {
+    if (launch.persistent) {
+      _environment->_release_buffer(launch.counter, sizeof(cl_uint), CL_MEM_READ_WRITE, nullptr, true);
+    }
+  }
+}
+
+}  // namespace mcl
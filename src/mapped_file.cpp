@@ -0,0 +1,106 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/mapped_file.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MCL_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mcl {
+
+// ===== MappedFile ====================================================================================================
+MappedFile::MappedFile(const std::filesystem::path& file, Mode mode, size_t size_Bytes) : _mode(mode), _path(file) {
+#ifdef MCL_HAS_MMAP
+  auto error = [&file](const std::string& what) {
+    return std::runtime_error("Could not " + what + " file '" + file.string() + "': " + std::strerror(errno));
+  };
+  const bool writable = mode == Mode::READ_WRITE;
+  int fd = ::open(file.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+  if (fd < 0) {
+    throw error("open");
+  }
+  if (writable && size_Bytes > 0 && ::ftruncate(fd, static_cast<off_t>(size_Bytes)) != 0) {
+    ::close(fd);
+    throw error("resize");
+  }
+  struct stat file_stat {};
+  if (::fstat(fd, &file_stat) != 0) {
+    ::close(fd);
+    throw error("stat");
+  }
+  _size = static_cast<size_t>(file_stat.st_size);
+  if (_size > 0) {
+    // read only files are mapped copy-on-write, so that the mapping can be used as regular host data
+    void* data = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw error("map");
+    }
+    _data = data;
+    ::madvise(_data, _size, MADV_SEQUENTIAL);
+  }
+  // the mapping stays valid after closing the file descriptor
+  ::close(fd);
+#else
+  throw std::runtime_error("MappedFile: memory mapped files are not supported on this platform (" + file.string() +
+                           ").");
+#endif
+}
+
+MappedFile::~MappedFile() { _unmap(); }
+
+MappedFile::MappedFile(MappedFile&& mapped_file) noexcept
+    : _data(std::exchange(mapped_file._data, nullptr)),
+      _size(std::exchange(mapped_file._size, 0)),
+      _mode(mapped_file._mode),
+      _path(std::move(mapped_file._path)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& mapped_file) noexcept {
+  if (this != &mapped_file) {
+    _unmap();
+    _data = std::exchange(mapped_file._data, nullptr);
+    _size = std::exchange(mapped_file._size, 0);
+    _mode = mapped_file._mode;
+    _path = std::move(mapped_file._path);
+  }
+  return *this;
+}
+
+void MappedFile::sync() {
+#ifdef MCL_HAS_MMAP
+  if (_data != nullptr && _mode == Mode::READ_WRITE && ::msync(_data, _size, MS_SYNC) != 0) {
+    throw std::runtime_error(std::string("Could not write mapped file: ") + std::strerror(errno));
+  }
+#endif
+}
+
+void MappedFile::_unmap() {
+#ifdef MCL_HAS_MMAP
+  if (_data != nullptr) {
+    ::munmap(_data, _size);
+  }
+#endif
+  _data = nullptr;
+  _size = 0;
+}
+
+}  // namespace mcl
@@ -0,0 +1,314 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/device.h>
+#include <missocl/multi_device.h>
+#include <missocl/opencl.h>
+#include <missocl/utils.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <stdexcept>
+
+namespace mcl {
+
+// ===== MultiDeviceExecutor ===========================================================================================
+MultiDeviceExecutor::MultiDeviceExecutor(const std::vector<Device*>& devices)
+    : MultiDeviceExecutor(devices, Options()) {}
+
+MultiDeviceExecutor::MultiDeviceExecutor(const std::vector<Device*>& devices, Options options)
+    : _options(options), _workers(std::max<size_t>(devices.size(), 1)) {
+  if (devices.empty()) {
+    throw std::runtime_error("MultiDeviceExecutor: no devices.");
+  }
+  // the transfers and the kernel run of a slice are ordered by the queue, without events
+  _options.environment.out_of_order = false;
+  double total_flops = 0;
+  for (auto* device : devices) {
+    _environments.push_back(std::make_unique<Environment>(device, _options.environment));
+    total_flops += static_cast<double>(device->estimated_flops());
+  }
+  for (auto* device : devices) {
+    _weights.push_back(total_flops > 0 ? static_cast<double>(device->estimated_flops()) / total_flops
+                                       : 1.0 / static_cast<double>(devices.size()));
+  }
+  _throughput.resize(devices.size(), 0);
+}
+
+void MultiDeviceExecutor::add_kernel(std::string name, const std::string& cl_c_source) {
+  // build the programs concurrently
+  std::vector<std::future<Kernel>> kernels;
+  for (auto& environment : _environments) {
+    kernels.push_back(environment->add_kernel_async(cl::NDRange(WORKGROUP_SIZE), name, cl_c_source));
+  }
+  _kernels.clear();
+  for (auto& kernel : kernels) {
+    _kernels.push_back(kernel.get());
+  }
+}
+
+void MultiDeviceExecutor::set_local_range(cl::NDRange local_range) { _local_range = local_range; }
+
+void MultiDeviceExecutor::run(cl::NDRange global_range, const std::vector<Argument>& arguments) {
+  size_t granularity = 0;
+  const size_t items = _split_items(global_range, granularity);
+  auto slices = _partition(items, granularity);
+
+  std::vector<std::future<void>> done(slices.size());
+  size_t first = 0;
+  for (size_t d = 0; d < slices.size(); ++d) {
+    if (slices[d] > 0) {
+      done[d] = _workers.submit([this, d, &global_range, first, &slices, &arguments]() {
+        const auto start = std::chrono::steady_clock::now();
+        _run_device(d, [&](std::vector<SliceBuffer>& buffers) {
+          _run_slice(d, global_range, first, slices[d], arguments, buffers);
+        });
+        _learn(d, slices[d], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      });
+    }
+    first += slices[d];
+  }
+  _wait(done);
+  if (_options.weighting == Weighting::MEASURED_THROUGHPUT) {
+    _update_weights();
+  }
+}
+
+void MultiDeviceExecutor::run_dynamic(cl::NDRange global_range, const std::vector<Argument>& arguments,
+                                      size_t min_tile_items) {
+  size_t granularity = 0;
+  const size_t items = _split_items(global_range, granularity);
+  const size_t min_tile = std::max((min_tile_items + granularity - 1) / granularity * granularity, granularity);
+
+  std::atomic<size_t> next_item{0};
+  std::vector<std::future<void>> done(_environments.size());
+  for (size_t d = 0; d < _environments.size(); ++d) {
+    done[d] = _workers.submit([this, d, items, granularity, min_tile, &next_item, &global_range, &arguments]() {
+      _run_device(d, [&](std::vector<SliceBuffer>& buffers) {
+        while (true) {
+          // claim the next tile, sized by the current throughput estimate of this device
+          size_t first = next_item.load();
+          size_t tile;
+          do {
+            if (first >= items) {
+              return;
+            }
+            tile = _tile_items(d, items - first, granularity, min_tile);
+          } while (!next_item.compare_exchange_weak(first, first + tile));
+          const auto start = std::chrono::steady_clock::now();
+          _run_slice(d, global_range, first, tile, arguments, buffers);
+          _learn(d, tile, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+      });
+    });
+  }
+  _wait(done);
+  if (_options.weighting == Weighting::MEASURED_THROUGHPUT) {
+    _update_weights();
+  }
+}
+
+const std::vector<double>& MultiDeviceExecutor::get_weights() const { return _weights; }
+
+std::vector<double> MultiDeviceExecutor::get_throughput() const {
+  std::lock_guard lock(_throughput_mutex);
+  return _throughput;
+}
+
+size_t MultiDeviceExecutor::device_count() const { return _environments.size(); }
+
+Environment& MultiDeviceExecutor::get_environment(size_t device_index) { return *_environments.at(device_index); }
+
+Kernel& MultiDeviceExecutor::get_kernel(size_t device_index) { return _kernels.at(device_index); }
+
+size_t MultiDeviceExecutor::_split_items(const cl::NDRange& global_range, size_t& granularity) const {
+  if (_kernels.empty()) {
+    throw std::runtime_error("MultiDeviceExecutor: no kernel added.");
+  }
+  if (global_range.dimensions() < 1 || global_range.dimensions() > 2) {
+    throw std::runtime_error("MultiDeviceExecutor: only 1 and 2 dimensional global ranges are supported.");
+  }
+  const size_t dim = global_range.dimensions() - 1;
+  granularity = WORKGROUP_SIZE;
+  if (_local_range.dimensions() == global_range.dimensions()) {
+    granularity = static_cast<const cl::size_type*>(_local_range)[dim];
+  } else if (_local_range.dimensions() == 0 && dim > 0) {
+    granularity = 1;
+  }
+  granularity = std::max<size_t>(granularity, 1);
+  return static_cast<const cl::size_type*>(global_range)[dim];
+}
+
+std::vector<size_t> MultiDeviceExecutor::_partition(size_t items, size_t granularity) const {
+  granularity = std::max<size_t>(granularity, 1);
+  std::vector<size_t> slices(_weights.size(), 0);
+  size_t assigned = 0;
+  for (size_t d = 0; d + 1 < _weights.size(); ++d) {
+    auto slice = static_cast<size_t>(_weights[d] * static_cast<double>(items));
+    slice = std::min(slice / granularity * granularity, items - assigned);
+    slices[d] = slice;
+    assigned += slice;
+  }
+  slices.back() = items - assigned;
+  return slices;
+}
+
+size_t MultiDeviceExecutor::_tile_items(size_t d, size_t remaining_items, size_t granularity, size_t min_tile) const {
+  // guided self-scheduling: half of the share of this device of the remaining items, so that tiles get smaller
+  // towards the end and all devices finish at about the same time
+  auto tile = static_cast<size_t>(_share(d) * static_cast<double>(remaining_items) / 2);
+  tile = std::max(tile / granularity * granularity, min_tile);
+  return std::min(tile, remaining_items);
+}
+
+double MultiDeviceExecutor::_share(size_t d) const {
+  std::lock_guard lock(_throughput_mutex);
+  if (_throughput[d] <= 0) {
+    return _weights[d];
+  }
+  // measured devices share the weight of all measured devices by throughput
+  double measured_weight = 0;
+  double measured_throughput = 0;
+  for (size_t i = 0; i < _throughput.size(); ++i) {
+    if (_throughput[i] > 0) {
+      measured_weight += _weights[i];
+      measured_throughput += _throughput[i];
+    }
+  }
+  return measured_weight * _throughput[d] / measured_throughput;
+}
+
+void MultiDeviceExecutor::_learn(size_t d, size_t items, double seconds) {
+  if (seconds <= 0) {
+    return;
+  }
+  double throughput = static_cast<double>(items) / seconds;
+  std::lock_guard lock(_throughput_mutex);
+  // exponential moving average, so that a single outlier does not move the whole split
+  _throughput[d] = _throughput[d] > 0 ? 0.7 * _throughput[d] + 0.3 * throughput : throughput;
+}
+
+void MultiDeviceExecutor::_update_weights() {
+  std::vector<double> shares(_weights.size());
+  for (size_t d = 0; d < _weights.size(); ++d) {
+    shares[d] = _share(d);
+  }
+  _weights = std::move(shares);
+}
+
+void MultiDeviceExecutor::_wait(std::vector<std::future<void>>& done) {
+  // wait for all devices before an error is passed on: the slices reference the host data
+  std::exception_ptr error;
+  for (auto& device_done : done) {
+    if (!device_done.valid()) {
+      continue;
+    }
+    try {
+      device_done.get();
+    } catch (...) {
+      error = std::current_exception();
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void MultiDeviceExecutor::_run_slice(size_t d, const cl::NDRange& global_range, size_t first, size_t items,
+                                     const std::vector<Argument>& arguments, std::vector<SliceBuffer>& buffers) {
+  Environment& environment = *_environments[d];
+  Kernel& kernel = _kernels[d];
+  cl::CommandQueue& queue = environment.get_cl_queue(kernel.get_queue());
+  buffers.resize(arguments.size());
+  for (cl_uint i = 0; i < arguments.size(); ++i) {
+    const Argument& argument = arguments[i];
+    auto& buffer = buffers[i];
+    switch (argument._kind) {
+      case Argument::Kind::SPLIT: {
+        size_t size_Bytes = items * argument._count * argument._element_Bytes;
+        size_t offset_Bytes = first * argument._count * argument._element_Bytes;
+        if (buffer.size_Bytes < size_Bytes) {
+          _release_buffer(d, buffer);
+          buffer.buffer = environment._allocate_buffer(size_Bytes, CL_MEM_READ_WRITE, nullptr, true);
+          buffer.size_Bytes = size_Bytes;
+        }
+        if (argument._access != Argument::Access::WRITE) {
+          check_opencl_error(queue.enqueueWriteBuffer(buffer.buffer, false, 0, size_Bytes,
+                                                      static_cast<char*>(argument._data) + offset_Bytes));
+        }
+        kernel.set_arg(i, buffer.buffer);
+        break;
+      }
+      case Argument::Kind::BROADCAST:
+        // uploaded once per run(...)
+        if (buffer.size_Bytes == 0) {
+          buffer.size_Bytes = argument._count * argument._element_Bytes;
+          buffer.buffer = environment._allocate_buffer(buffer.size_Bytes, CL_MEM_READ_WRITE, nullptr, true);
+          check_opencl_error(queue.enqueueWriteBuffer(buffer.buffer, false, 0, buffer.size_Bytes, argument._data));
+        }
+        kernel.set_arg(i, buffer.buffer);
+        break;
+      case Argument::Kind::SCALAR:
+        check_opencl_error(kernel._cl_kernel.setArg(i, argument._value.size(), argument._value.data()));
+        break;
+      case Argument::Kind::OFFSET:
+        kernel.set_arg(i, static_cast<cl_ulong>(first));
+        break;
+    }
+  }
+  const cl::size_type* global = global_range;
+  cl::NDRange slice_range = global_range.dimensions() == 1 ? cl::NDRange(items) : cl::NDRange(global[0], items);
+  cl::NDRange local_range = _local_range;
+  if (local_range.dimensions() == 0 && global_range.dimensions() == 1) {
+    local_range = cl::NDRange(WORKGROUP_SIZE);
+  }
+  kernel.set_range(slice_range, local_range);
+  kernel.enqueue_run();
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    const Argument& argument = arguments[i];
+    if (argument._kind == Argument::Kind::SPLIT && argument._access != Argument::Access::READ) {
+      size_t offset_Bytes = first * argument._count * argument._element_Bytes;
+      check_opencl_error(queue.enqueueReadBuffer(buffers[i].buffer, false, 0,
+                                                 items * argument._count * argument._element_Bytes,
+                                                 static_cast<char*>(argument._data) + offset_Bytes));
+    }
+  }
+  check_opencl_error(queue.finish());
+}
+
+void MultiDeviceExecutor::_release_buffer(size_t d, SliceBuffer& buffer) {
+  if (buffer.size_Bytes > 0) {
+    _environments[d]->_release_buffer(buffer.buffer, buffer.size_Bytes, CL_MEM_READ_WRITE, nullptr, true);
+    buffer.size_Bytes = 0;
+  }
+}
+
+void MultiDeviceExecutor::_run_device(size_t d, const std::function<void(std::vector<SliceBuffer>&)>& work) {
+  std::vector<SliceBuffer> buffers;
+  try {
+    work(buffers);
+  } catch (...) {
+    // the buffers may still be in use by enqueued commands
+    _environments[d]->finish();
+    for (auto& buffer : buffers) {
+      _release_buffer(d, buffer);
+    }
+    throw;
+  }
+  for (auto& buffer : buffers) {
+    _release_buffer(d, buffer);
+  }
+}
+
+}  // namespace mcl
@@ -0,0 +1,237 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/profiler.h>
+#include <missocl/utils.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace mcl {
+
+namespace {
+std::string json_escape(const std::string& str) {
+  std::string escaped;
+  escaped.reserve(str.size());
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buffer[8];
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+          escaped += buffer;
+        } else {
+          escaped += c;
+        }
+    }
+  }
+  return escaped;
+}
+}  // namespace
+
+// ===== Profiler ======================================================================================================
+double Profiler::Statistics::gb_per_s() const {
+  // Bytes per nanosecond equals GB per second
+  return total_ms > 0 ? static_cast<double>(bytes) / (total_ms * 1e6) : 0;
+}
+
+double Profiler::Statistics::gflop_per_s() const {
+  return total_ms > 0 ? static_cast<double>(flops) / (total_ms * 1e6) : 0;
+}
+
+void Profiler::record(Record record, cl::Event event) {
+  record.host_thread = std::this_thread::get_id();
+  record.host_enqueue_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now().time_since_epoch())
+                               .count();
+  std::lock_guard lock(_mutex);
+  _pending.push_back({std::move(record), std::move(event)});
+}
+
+std::vector<Profiler::Record> Profiler::records() {
+  std::lock_guard lock(_mutex);
+  _resolve();
+  return _records;
+}
+
+std::vector<Profiler::Statistics> Profiler::statistics() {
+  std::map<std::pair<Command, std::string>, std::vector<const Record*>> grouped;
+  std::lock_guard lock(_mutex);
+  _resolve();
+  for (const auto& record : _records) {
+    grouped[{record.command, record.name}].push_back(&record);
+  }
+  std::vector<Statistics> result;
+  for (auto& [key, records] : grouped) {
+    Statistics statistics{key.first, key.second};
+    std::vector<cl_ulong> durations;
+    durations.reserve(records.size());
+    for (const auto* record : records) {
+      durations.push_back(record->duration_ns());
+      statistics.bytes += record->bytes;
+      statistics.flops += record->flops;
+    }
+    std::sort(durations.begin(), durations.end());
+    cl_ulong total = 0;
+    for (auto duration : durations) {
+      total += duration;
+    }
+    // nearest rank percentile
+    size_t p99_rank = (durations.size() * 99 + 99) / 100;
+    statistics.count = durations.size();
+    statistics.min_ms = static_cast<double>(durations.front()) / 1e6;
+    statistics.p99_ms = static_cast<double>(durations[p99_rank - 1]) / 1e6;
+    statistics.total_ms = static_cast<double>(total) / 1e6;
+    statistics.mean_ms = statistics.total_ms / static_cast<double>(statistics.count);
+    result.push_back(std::move(statistics));
+  }
+  return result;
+}
+
+void Profiler::print(std::ostream& os) {
+  os << std::left << std::setw(8) << "Command" << std::setw(24) << "Name" << std::right << std::setw(8) << "Count"
+     << std::setw(12) << "Min (ms)" << std::setw(12) << "Mean (ms)" << std::setw(12) << "P99 (ms)" << std::setw(12)
+     << "GB/s" << std::setw(12) << "GFLOP/s" << '\n';
+  for (const auto& s : statistics()) {
+    os << std::left << std::setw(8) << s.command << std::setw(24) << s.name << std::right << std::setw(8) << s.count
+       << std::fixed << std::setprecision(4) << std::setw(12) << s.min_ms << std::setw(12) << s.mean_ms
+       << std::setw(12) << s.p99_ms << std::setprecision(2) << std::setw(12) << s.gb_per_s() << std::setw(12)
+       << s.gflop_per_s() << '\n';
+  }
+  os << std::defaultfloat;
+}
+
+void Profiler::write_chrome_trace(const std::filesystem::path& file, const std::string& device_name) {
+  auto all_records = records();
+  std::ofstream out(file);
+  if (!out) {
+    throw std::runtime_error("Could not write file '" + file.string() + "'.");
+  }
+  // device and host clocks are unrelated: both are shifted to start at 0
+  cl_ulong device_begin = std::numeric_limits<cl_ulong>::max();
+  uint64_t host_begin = std::numeric_limits<uint64_t>::max();
+  std::set<unsigned> queues;
+  std::map<std::thread::id, size_t> host_threads;
+  for (const auto& record : all_records) {
+    device_begin = std::min(device_begin, record.queued);
+    host_begin = std::min(host_begin, record.host_enqueue_ns);
+    queues.insert(record.queue_index);
+    host_threads.emplace(record.host_thread, host_threads.size());
+  }
+  auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+  auto range_str = [](const std::vector<cl::size_type>& range) {
+    std::string str = "[";
+    for (size_t i = 0; i < range.size(); ++i) {
+      str += (i > 0 ? ", " : "") + std::to_string(range[i]);
+    }
+    return str + "]";
+  };
+  constexpr int device_pid = 1;
+  constexpr int host_pid = 2;
+
+  out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+  out << R"({"ph": "M", "name": "process_name", "pid": )" << device_pid << R"(, "args": {"name": ")"
+      << json_escape(device_name) << "\"}}";
+  out << ",\n" << R"({"ph": "M", "name": "process_name", "pid": )" << host_pid << R"(, "args": {"name": "Host"}})";
+  for (auto queue_index : queues) {
+    out << ",\n"
+        << R"({"ph": "M", "name": "thread_name", "pid": )" << device_pid << R"(, "tid": )" << queue_index
+        << R"(, "args": {"name": "Queue )" << queue_index << "\"}}";
+  }
+  for (const auto& [thread, tid] : host_threads) {
+    out << ",\n"
+        << R"({"ph": "M", "name": "thread_name", "pid": )" << host_pid << R"(, "tid": )" << tid
+        << R"(, "args": {"name": "Host thread )" << tid << "\"}}";
+  }
+  for (const auto& record : all_records) {
+    std::stringstream command;
+    command << record.command;
+    std::string name = json_escape(record.name);
+    out << ",\n"
+        << R"({"ph": "X", "name": ")" << name << R"(", "cat": ")" << command.str() << R"(", "pid": )" << device_pid
+        << R"(, "tid": )" << record.queue_index << R"(, "ts": )" << us(record.start - device_begin)
+        << R"(, "dur": )" << us(record.duration_ns()) << R"(, "args": {"bytes": )" << record.bytes;
+    if (record.command == Command::KERNEL) {
+      out << R"(, "global_range": ")" << range_str(record.global_range) << R"(", "local_range": ")"
+          << range_str(record.local_range) << R"(", "flops": )" << record.flops;
+    }
+    out << R"(, "queued_us": )" << us(record.queued - device_begin) << R"(, "submit_us": )"
+        << us(record.submit - device_begin) << R"(, "host_enqueue_us": )" << us(record.host_enqueue_ns - host_begin)
+        << "}}";
+    out << ",\n"
+        << R"({"ph": "i", "s": "t", "name": "enqueue )" << name << R"(", "cat": ")" << command.str()
+        << R"(", "pid": )" << host_pid << R"(, "tid": )" << host_threads[record.host_thread] << R"(, "ts": )"
+        << us(record.host_enqueue_ns - host_begin) << "}";
+  }
+  out << "\n]}\n";
+}
+
+void Profiler::clear() {
+  std::lock_guard lock(_mutex);
+  _pending.clear();
+  _records.clear();
+}
+
+void Profiler::_resolve() {
+  if (_pending.empty()) {
+    return;
+  }
+  std::vector<cl::Event> events;
+  events.reserve(_pending.size());
+  for (const auto& pending : _pending) {
+    events.push_back(pending.event);
+  }
+  check_opencl_error(cl::Event::waitForEvents(events));
+  for (auto& pending : _pending) {
+    pending.record.queued = pending.event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+    pending.record.submit = pending.event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>();
+    pending.record.start = pending.event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    pending.record.end = pending.event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+    _records.push_back(std::move(pending.record));
+  }
+  _pending.clear();
+}
+
+std::ostream& operator<<(std::ostream& os, const Profiler::Command& command) {
+  switch (command) {
+    case Profiler::Command::KERNEL:
+      return os << "KERNEL";
+    case Profiler::Command::WRITE:
+      return os << "WRITE";
+    case Profiler::Command::READ:
+      return os << "READ";
+    case Profiler::Command::FILL:
+      return os << "FILL";
+    case Profiler::Command::COPY:
+      return os << "COPY";
+  }
+  return os;
+}
+
+}  // namespace mcl
@@ -0,0 +1,208 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/device.h>
+#include <missocl/program_cache.h>
+#include <missocl/utils.h>
+
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+namespace mcl {
+
+namespace {
+// identifies a cache file: "MCLPROG" + format version
+constexpr char cache_file_magic[8] = {'M', 'C', 'L', 'P', 'R', 'O', 'G', '1'};
+
+void CL_CALLBACK build_notify(cl_program, void* user_data) {
+  auto* built = static_cast<std::shared_ptr<std::promise<void>>*>(user_data);
+  (*built)->set_value();
+  delete built;
+}
+
+/**
+ * Builds program for device using the pfn_notify callback of clBuildProgram. Drivers that build asynchronously return
+ * immediately and signal completion through the callback, others call it before clBuildProgram returns. Either way,
+ * this function returns once the build finished.
+ */
+cl_int build_program(const cl::Program& program, const cl::Device& device, const std::string& build_options) {
+  auto built = std::make_shared<std::promise<void>>();
+  auto done = built->get_future();
+  // owned by build_notify; leaks if the driver refuses to start the build and never calls it
+  auto* notify_data = new std::shared_ptr<std::promise<void>>(built);
+  cl_device_id device_id = device();
+  cl_int error = clBuildProgram(program(), 1, &device_id, build_options.c_str(), build_notify, notify_data);
+  if (error != CL_SUCCESS) {
+    return error;
+  }
+  done.wait();
+  return program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) == CL_BUILD_SUCCESS ? CL_SUCCESS
+                                                                                   : CL_BUILD_PROGRAM_FAILURE;
+}
+}  // namespace
+
+// ===== ProgramCache ==================================================================================================
+ProgramCache::ProgramCache() {
+  auto directory = default_cache_directory();
+  if (!directory.empty()) {
+    _directory = directory / "programs";
+  }
+}
+
+ProgramCache& ProgramCache::get_instance() {
+  static ProgramCache program_cache;
+  return program_cache;
+}
+
+void ProgramCache::set_directory(std::filesystem::path directory) {
+  auto& pc = get_instance();
+  std::lock_guard lock(pc._mutex);
+  pc._directory = std::move(directory);
+}
+
+std::filesystem::path ProgramCache::get_directory() {
+  auto& pc = get_instance();
+  std::lock_guard lock(pc._mutex);
+  return pc._directory;
+}
+
+bool ProgramCache::enabled() { return !get_directory().empty(); }
+
+uint64_t ProgramCache::hits() { return get_instance()._hits; }
+
+uint64_t ProgramCache::misses() { return get_instance()._misses; }
+
+void ProgramCache::reset_statistics() {
+  auto& pc = get_instance();
+  pc._hits = 0;
+  pc._misses = 0;
+}
+
+cl::Program ProgramCache::build(const cl::Context& context, const Device& device, const std::string& source,
+                                const std::string& build_options) {
+  auto& pc = get_instance();
+  auto directory = get_directory();
+  if (directory.empty()) {
+    return _build_from_source(context, device, source, build_options);
+  }
+  uint64_t key = _key(device, source, build_options);
+  std::stringstream file_name;
+  file_name << std::hex << key << ".bin";
+  auto file = directory / file_name.str();
+
+  cl::Program program;
+  if (pc._load(file, key, context, device, build_options, program)) {
+    pc._hits++;
+    return program;
+  }
+  pc._misses++;
+  program = _build_from_source(context, device, source, build_options);
+  pc._store(file, key, device, program);
+  return program;
+}
+
+uint64_t ProgramCache::_key(const Device& device, const std::string& source, const std::string& build_options) {
+  // the '\0' separators make sure that e.g. ("ab", "c") and ("a", "bc") result in different keys
+  uint64_t key = fnv1a_64(source);
+  key = fnv1a_64({"\0", 1}, key);
+  key = fnv1a_64(build_options, key);
+  key = fnv1a_64({"\0", 1}, key);
+  key = fnv1a_64(device.name(), key);
+  key = fnv1a_64({"\0", 1}, key);
+  key = fnv1a_64(device.driver_version(), key);
+  key = fnv1a_64({"\0", 1}, key);
+  return fnv1a_64(device.opencl_c_version(), key);
+}
+
+cl::Program ProgramCache::_build_from_source(const cl::Context& context, const Device& device,
+                                             const std::string& source, const std::string& build_options) {
+  cl::Program::Sources sources;
+  sources.push_back(source);
+  cl::Program cl_program(context, sources);
+  cl_int error = build_program(cl_program, device.get_cl_device(), build_options);
+  if (error == CL_BUILD_PROGRAM_FAILURE) {
+    std::cerr << cl_program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device.get_cl_device()) << std::endl;
+  }
+  check_opencl_error(error);
+  return cl_program;
+}
+
+bool ProgramCache::_load(const std::filesystem::path& file, uint64_t key, const cl::Context& context,
+                         const Device& device, const std::string& build_options, cl::Program& program) {
+  std::ifstream in(file, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  char magic[sizeof(cache_file_magic)];
+  uint64_t stored_key = 0;
+  uint64_t binary_size = 0;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char*>(&stored_key), sizeof(stored_key));
+  in.read(reinterpret_cast<char*>(&binary_size), sizeof(binary_size));
+  if (!in || std::memcmp(magic, cache_file_magic, sizeof(magic)) != 0 || stored_key != key || binary_size == 0) {
+    return false;
+  }
+  cl::Program::Binaries binaries(1, std::vector<unsigned char>(binary_size));
+  in.read(reinterpret_cast<char*>(binaries[0].data()), static_cast<std::streamsize>(binary_size));
+  if (!in) {
+    return false;
+  }
+  try {
+    std::vector<cl_int> binary_status;
+    cl_int error = CL_SUCCESS;
+    cl::Program cl_program(context, {device.get_cl_device()}, binaries, &binary_status, &error);
+    if (error != CL_SUCCESS || binary_status.empty() || binary_status[0] != CL_SUCCESS) {
+      return false;
+    }
+    // a program created from a binary still needs to be built, but this only links the executable
+    if (build_program(cl_program, device.get_cl_device(), build_options) != CL_SUCCESS) {
+      return false;
+    }
+    program = std::move(cl_program);
+  } catch (const cl::Error&) {
+    // binary was rejected by the driver (e.g. after a driver update): fall back to building from source
+    return false;
+  }
+  return true;
+}
+
+void ProgramCache::_store(const std::filesystem::path& file, uint64_t key, const Device& device,
+                          const cl::Program& program) {
+  // the program may be created for all devices of a shared context (see Environment::create_shared(...)), but it is
+  // only built for device: binaries are ordered like CL_PROGRAM_DEVICES and empty for the other devices
+  auto devices = program.getInfo<CL_PROGRAM_DEVICES>();
+  auto binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+  size_t index = 0;
+  while (index < devices.size() && devices[index]() != device.get_cl_device()()) {
+    ++index;
+  }
+  if (index >= devices.size() || index >= binaries.size() || binaries[index].empty()) {
+    return;
+  }
+  const auto& binary = binaries[index];
+  write_file_atomically(
+      file,
+      [&](std::ostream& out) {
+        uint64_t binary_size = binary.size();
+        out.write(cache_file_magic, sizeof(cache_file_magic));
+        out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        out.write(reinterpret_cast<const char*>(&binary_size), sizeof(binary_size));
+        out.write(reinterpret_cast<const char*>(binary.data()), static_cast<std::streamsize>(binary_size));
+        return static_cast<bool>(out);
+      },
+      true);
+}
+
+}  // namespace mcl
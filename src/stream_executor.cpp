@@ -0,0 +1,155 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/device.h>
+#include <missocl/environment.h>
+#include <missocl/kernel.h>
+#include <missocl/stream_executor.h>
+#include <missocl/utils.h>
+
+#include <algorithm>
+
+namespace mcl {
+
+// ===== StreamExecutor ================================================================================================
+StreamExecutor::StreamExecutor(Environment& environment, Kernel& kernel)
+    : StreamExecutor(environment, kernel, Options()) {}
+
+StreamExecutor::StreamExecutor(Environment& environment, Kernel& kernel, Options options)
+    : _environment(&environment), _kernel(&kernel), _options(options) {
+  _options.depth = std::max(_options.depth, 1u);
+}
+
+size_t StreamExecutor::chunk_size(size_t input_element_Bytes, size_t output_element_Bytes) const {
+  if (_options.chunk_size > 0) {
+    return _options.chunk_size;
+  }
+  const Device* device = _environment->get_device();
+  // use half of the available memory, the rest is left to other allocations
+  uint64_t chunk_Bytes = device->memory_available_Bytes() / 2 / _options.depth;
+  size_t chunk = chunk_Bytes / std::max<size_t>(input_element_Bytes + output_element_Bytes, 1);
+  uint64_t max_buffer_Bytes = device->max_global_buffer_Bytes();
+  chunk = std::min(chunk, static_cast<size_t>(max_buffer_Bytes / std::max(input_element_Bytes, output_element_Bytes)));
+  // full work groups for all chunks but the last
+  const cl::NDRange& local = _kernel->get_local_range();
+  size_t local_size = local.dimensions() > 0 ? static_cast<const cl::size_type*>(local)[0] : 1;
+  return std::max(chunk / local_size * local_size, local_size);
+}
+
+void StreamExecutor::_run(const void* input, size_t input_element_Bytes, void* output, size_t output_element_Bytes,
+                          size_t count) {
+  if (count == 0) {
+    return;
+  }
+  const size_t chunk = std::min(chunk_size(input_element_Bytes, output_element_Bytes), count);
+  const size_t chunks = (count + chunk - 1) / chunk;
+  const unsigned depth = std::min<size_t>(_options.depth, chunks);
+  const cl::NDRange local = _kernel->get_local_range();
+  const size_t local_size = local.dimensions() > 0 ? static_cast<const cl::size_type*>(local)[0] : 1;
+
+  // the kernel keeps its queue, transfers use the next ones (if available)
+  const unsigned queues = _environment->queue_count();
+  const unsigned kernel_queue = _kernel->get_queue();
+  const unsigned upload_index = (kernel_queue + (queues > 1 ? 1 : 0)) % queues;
+  const unsigned download_index = (kernel_queue + (queues > 2 ? 2 : queues - 1)) % queues;
+  cl::CommandQueue& upload = _environment->get_cl_queue(upload_index);
+  cl::CommandQueue& download = _environment->get_cl_queue(download_index);
+
+  struct Slot {
+    cl::Buffer input;
+    cl::Buffer output;
+    /// the last kernel that read input and wrote output
+    cl::Event processed;
+    /// the last download of output
+    cl::Event downloaded;
+  };
+  std::vector<Slot> slots(depth);
+  auto release_slots = [&]() {
+    for (auto& slot : slots) {
+      if (slot.input() != nullptr) {
+        _environment->_release_buffer(slot.input, chunk * input_element_Bytes, CL_MEM_READ_ONLY, nullptr, true);
+      }
+      if (slot.output() != nullptr) {
+        _environment->_release_buffer(slot.output, chunk * output_element_Bytes, CL_MEM_WRITE_ONLY, nullptr, true);
+      }
+    }
+  };
+
+  auto run_chunks = [&]() {
+    for (auto& slot : slots) {
+      slot.input = _environment->_allocate_buffer(chunk * input_element_Bytes, CL_MEM_READ_ONLY, nullptr, true);
+      slot.output = _environment->_allocate_buffer(chunk * output_element_Bytes, CL_MEM_WRITE_ONLY, nullptr, true);
+    }
+    for (size_t c = 0; c < chunks; ++c) {
+      Slot& slot = slots[c % depth];
+      const size_t offset = c * chunk;
+      const size_t n = std::min(chunk, count - offset);
+
+      // upload: input of the slot must not be read by a kernel anymore
+      std::vector<cl::Event> upload_waitlist;
+      if (slot.processed() != nullptr) {
+        upload_waitlist.push_back(slot.processed);
+      }
+      cl::Event uploaded;
+      check_opencl_error(upload.enqueueWriteBuffer(slot.input, false, 0, n * input_element_Bytes,
+                                                   static_cast<const char*>(input) + offset * input_element_Bytes,
+                                                   &upload_waitlist, &uploaded));
+      _environment->_record({.command = Profiler::Command::WRITE,
+                             .name = "stream input",
+                             .queue_index = upload_index,
+                             .bytes = n * input_element_Bytes},
+                            uploaded);
+
+      // process: output of the slot must be downloaded
+      std::vector<cl::Event> kernel_waitlist{uploaded};
+      if (slot.downloaded() != nullptr) {
+        kernel_waitlist.push_back(slot.downloaded);
+      }
+      _kernel->set_arg(0, slot.input);
+      _kernel->set_arg(1, slot.output);
+      _kernel->set_arg(2, static_cast<cl_ulong>(n));
+      if (_kernel->has_range_parameters()) {
+        _kernel->set_range(cl::NDRange(n), local);
+      } else {
+        _kernel->set_range(cl::NDRange((n + local_size - 1) / local_size * local_size), local);
+      }
+      _kernel->enqueue_run(1, &kernel_waitlist, &slot.processed);
+
+      // download
+      std::vector<cl::Event> download_waitlist{slot.processed};
+      check_opencl_error(download.enqueueReadBuffer(slot.output, false, 0, n * output_element_Bytes,
+                                                    static_cast<char*>(output) + offset * output_element_Bytes,
+                                                    &download_waitlist, &slot.downloaded));
+      _environment->_record({.command = Profiler::Command::READ,
+                             .name = "stream output",
+                             .queue_index = download_index,
+                             .bytes = n * output_element_Bytes},
+                            slot.downloaded);
+      // start the work of this chunk while the next one is enqueued
+      _environment->flush();
+    }
+    for (auto& slot : slots) {
+      check_opencl_error(slot.downloaded.wait());
+    }
+  };
+
+  try {
+    run_chunks();
+  } catch (...) {
+    // the buffers may still be in use by enqueued commands
+    _environment->finish();
+    release_slots();
+    throw;
+  }
+  release_slots();
+}
+
+}  // namespace mcl
@@ -0,0 +1,208 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/kernel.h>
+#include <missocl/task_graph.h>
+#include <missocl/utils.h>
+
+#include <map>
+#include <set>
+#include <stdexcept>
+
+namespace mcl {
+
+// ===== TaskGraph =====================================================================================================
+bool TaskGraph::Access::operator<(const Access& other) const {
+  return memory != other.memory ? memory < other.memory : host < other.host;
+}
+
+TaskGraph::TaskGraph(Environment& environment) : _environment(&environment) {}
+
+TaskGraph::Node TaskGraph::add_kernel(Kernel& kernel, std::vector<const MemoryObject*> reads,
+                                      std::vector<const MemoryObject*> writes, unsigned runs) {
+  return _add({Kind::KERNEL, kernel.get_name(), kernel.get_queue(),
+               [&kernel, runs](unsigned queue, const std::vector<cl::Event>* waitlist, cl::Event* event) {
+                 auto kernel_queue = kernel.get_queue();
+                 kernel.set_queue(queue);
+                 kernel.enqueue_run(runs, waitlist, event);
+                 kernel.set_queue(kernel_queue);
+               },
+               _device_access(reads), _device_access(writes)});
+}
+
+TaskGraph::Node TaskGraph::add_host(std::function<void()> function, std::vector<const MemoryObject*> reads,
+                                    std::vector<const MemoryObject*> writes) {
+  return _add({Kind::HOST, "host", 0,
+               [function = std::move(function)](unsigned, const std::vector<cl::Event>* waitlist, cl::Event*) {
+                 if (waitlist != nullptr && !waitlist->empty()) {
+                   check_opencl_error(cl::Event::waitForEvents(*waitlist));
+                 }
+                 function();
+               },
+               _host_access(reads), _host_access(writes)});
+}
+
+void TaskGraph::launch() {
+  if (!_compiled) {
+    _compile();
+  }
+  const size_t n = _nodes.size();
+  std::swap(_events, _previous_events);
+  for (Node i = 0; i < n; ++i) {
+    auto& node = _nodes[i];
+    _waitlist.clear();
+    for (size_t wait : node.waits) {
+      const auto& event = wait < n ? _previous_events[wait] : _events[wait - n];
+      // null in the first launch
+      if (event() != nullptr) {
+        _waitlist.push_back(event);
+      }
+    }
+    _events[i] = cl::Event();
+    node.enqueue(node.queue, _waitlist.empty() ? nullptr : &_waitlist, node.signals ? &_events[i] : nullptr);
+  }
+  _environment->flush();
+}
+
+void TaskGraph::run(unsigned iterations) {
+  for (unsigned i = 0; i < iterations; ++i) {
+    launch();
+  }
+  finish();
+}
+
+void TaskGraph::finish() { _environment->finish(); }
+
+size_t TaskGraph::size() const { return _nodes.size(); }
+
+std::vector<TaskGraph::Node> TaskGraph::waits(Node node) {
+  if (node >= _nodes.size()) {
+    throw std::runtime_error("TaskGraph: node " + std::to_string(node) + " does not exist.");
+  }
+  if (!_compiled) {
+    _compile();
+  }
+  std::set<Node> nodes;
+  for (size_t wait : _nodes[node].waits) {
+    nodes.insert(wait % _nodes.size());
+  }
+  return {nodes.begin(), nodes.end()};
+}
+
+TaskGraph::Node TaskGraph::_add(NodeData node) {
+  if (node.kind != Kind::HOST) {
+    node.queue = _environment->_checked_queue_index(node.queue);
+  }
+  _nodes.push_back(std::move(node));
+  _compiled = false;
+  return _nodes.size() - 1;
+}
+
+std::vector<TaskGraph::Access> TaskGraph::_device_access(const std::vector<const MemoryObject*>& memory) {
+  std::vector<Access> access;
+  for (const auto* m : memory) {
+    access.push_back({m, false});
+  }
+  return access;
+}
+
+std::vector<TaskGraph::Access> TaskGraph::_host_access(const std::vector<const MemoryObject*>& memory) {
+  std::vector<Access> access;
+  for (const auto* m : memory) {
+    access.push_back({m, true});
+  }
+  return access;
+}
+
+unsigned TaskGraph::_upload_queue() const { return std::min(1u, _environment->queue_count() - 1); }
+
+unsigned TaskGraph::_download_queue() const { return std::min(2u, _environment->queue_count() - 1); }
+
+void TaskGraph::_compile() {
+  const size_t n = _nodes.size();
+  const bool in_order = !_environment->out_of_order();
+  struct State {
+    long long last_writer{-1};
+    std::vector<size_t> readers;
+  };
+  std::map<Access, State> states;
+
+  // two consecutive launches are inferred: dependencies of the second on the first are those across launches.
+  // Position p < n is node p of the previous launch, p >= n is node p - n of the current launch.
+  for (size_t p = 0; p < 2 * n; ++p) {
+    auto& node = _nodes[p % n];
+    std::set<size_t> dependencies;
+    for (const auto& access : node.reads) {
+      auto& state = states[access];
+      if (state.last_writer >= 0) {
+        dependencies.insert(state.last_writer);
+      }
+    }
+    for (const auto& access : node.writes) {
+      auto& state = states[access];
+      if (state.last_writer >= 0) {
+        dependencies.insert(state.last_writer);
+      }
+      dependencies.insert(state.readers.begin(), state.readers.end());
+    }
+    for (const auto& access : node.reads) {
+      states[access].readers.push_back(p);
+    }
+    for (const auto& access : node.writes) {
+      auto& state = states[access];
+      state.last_writer = static_cast<long long>(p);
+      state.readers.clear();
+    }
+    if (p < n) {
+      continue;
+    }
+
+    // reduce the dependencies of node i to the last one per queue (all of them for out-of-order queues)
+    const size_t i = p - n;
+    std::map<unsigned, size_t> last_per_queue;
+    node.waits.clear();
+    for (size_t dependency : dependencies) {
+      const auto& other = _nodes[dependency % n];
+      // host nodes are finished when the nodes behind them are enqueued; within an in-order queue, commands are
+      // ordered anyway
+      if (other.kind == Kind::HOST || (in_order && node.kind != Kind::HOST && other.queue == node.queue)) {
+        continue;
+      }
+      // a node of the previous launch in front of i was enqueued again in this launch before i and is waited for
+      // through its current instance (an in-order queue runs it after the previous one)
+      if (dependency < n && dependency % n < i && in_order) {
+        continue;
+      }
+      if (!in_order) {
+        node.waits.push_back(dependency);
+        continue;
+      }
+      auto& last = last_per_queue[other.queue];
+      last = std::max(last, dependency);
+    }
+    for (auto [queue, dependency] : last_per_queue) {
+      node.waits.push_back(dependency);
+    }
+  }
+  for (auto& node : _nodes) {
+    node.signals = false;
+  }
+  for (auto& node : _nodes) {
+    for (size_t wait : node.waits) {
+      _nodes[wait % n].signals = true;
+    }
+  }
+  _events.assign(n, cl::Event());
+  _previous_events.assign(n, cl::Event());
+  _compiled = true;
+}
+
+}  // namespace mcl
@@ -0,0 +1,72 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/thread_pool.h>
+
+#include <algorithm>
+
+namespace mcl {
+
+// ===== ThreadPool ====================================================================================================
+ThreadPool::ThreadPool(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  _workers.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    _workers.emplace_back(&ThreadPool::_work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(_mutex);
+    _stop = true;
+  }
+  _cv.notify_all();
+  for (auto& worker : _workers) {
+    worker.join();
+  }
+}
+
+ThreadPool& ThreadPool::global() {
+  static ThreadPool thread_pool;
+  return thread_pool;
+}
+
+size_t ThreadPool::size() const { return _workers.size(); }
+
+void ThreadPool::_push(std::function<void()> task) {
+  {
+    std::lock_guard lock(_mutex);
+    _tasks.push(std::move(task));
+  }
+  _cv.notify_one();
+}
+
+void ThreadPool::_work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(_mutex);
+      _cv.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+      if (_tasks.empty()) {
+        // _stop is set and all remaining tasks are done
+        return;
+      }
+      task = std::move(_tasks.front());
+      _tasks.pop();
+    }
+    task();
+  }
+}
+
+}  // namespace mcl
@@ -0,0 +1,131 @@
+/**
+ * Author: Leon Freist <freist.leon@gmail.com>
+ *
+ * This file belongs to MISS-OCL.
+ * MISS-OCL is licensed under
+ *  A) MIT-License:    Copyright (c) 2023 Leon Freist
+ *  B) The Unlicensed: This is free and unencumbered software released into the
+ *     public domain
+ * You are free to chose the license whichever you prefer.
+ */
+
+#include <missocl/tuning.h>
+#include <missocl/utils.h>
+
+#include <iostream>
+#include <sstream>
+
+namespace mcl {
+
+// ===== TuningDatabase ================================================================================================
+TuningDatabase::TuningDatabase() {
+  auto directory = default_cache_directory();
+  if (!directory.empty()) {
+    _file = directory / "tuning.db";
+  }
+}
+
+TuningDatabase& TuningDatabase::get_instance() {
+  static TuningDatabase tuning_database;
+  return tuning_database;
+}
+
+void TuningDatabase::set_file(std::filesystem::path file) {
+  auto& db = get_instance();
+  std::lock_guard lock(db._mutex);
+  db._file = std::move(file);
+  db._entries.clear();
+  db._read_done = false;
+}
+
+std::filesystem::path TuningDatabase::get_file() {
+  auto& db = get_instance();
+  std::lock_guard lock(db._mutex);
+  return db._file;
+}
+
+std::optional<std::vector<cl::size_type>> TuningDatabase::load(const std::string& key) {
+  auto& db = get_instance();
+  std::lock_guard lock(db._mutex);
+  db._read();
+  auto it = db._entries.find(key);
+  if (it == db._entries.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+void TuningDatabase::store(const std::string& key, const std::vector<cl::size_type>& local_range) {
+  auto& db = get_instance();
+  std::lock_guard lock(db._mutex);
+  db._read();
+  db._entries[key] = local_range;
+  db._write();
+}
+
+std::string TuningDatabase::make_key(const std::string& device_name, const std::string& driver_version,
+                                     const std::string& kernel_name, uint64_t program_hash,
+                                     const cl::NDRange& global_range) {
+  std::stringstream ss;
+  ss << device_name << '|' << driver_version << '|' << kernel_name << '|' << std::hex << program_hash << std::dec
+     << '|';
+  const cl::size_type* global = global_range;
+  for (cl::size_type i = 0; i < global_range.dimensions(); ++i) {
+    ss << (i > 0 ? "x" : "") << global[i];
+  }
+  std::string key = ss.str();
+  for (char& c : key) {
+    if (c == '\t' || c == '\n' || c == '\r') {
+      c = ' ';
+    }
+  }
+  return key;
+}
+
+void TuningDatabase::_read() {
+  if (_read_done) {
+    return;
+  }
+  _read_done = true;
+  _merge_file();
+}
+
+void TuningDatabase::_merge_file() {
+  if (_file.empty()) {
+    return;
+  }
+  // format: one entry per line, "<key>\t<local range, space separated>" (empty local range: driver choice)
+  read_key_value_file(_file, [this](const std::string& key, const std::string& line) {
+    std::vector<cl::size_type> local_range;
+    std::stringstream values(line);
+    cl::size_type value;
+    while (values >> value) {
+      local_range.push_back(value);
+    }
+    // entries that are already known take precedence over the file
+    _entries.emplace(key, std::move(local_range));
+  });
+}
+
+void TuningDatabase::_write() {
+  if (_file.empty()) {
+    return;
+  }
+  // another process may have tuned other kernels in the meantime: keep its entries
+  _merge_file();
+  bool written = write_file_atomically(_file, [this](std::ostream& out) {
+    for (const auto& [key, local_range] : _entries) {
+      out << key << '\t';
+      for (size_t i = 0; i < local_range.size(); ++i) {
+        out << (i > 0 ? " " : "") << local_range[i];
+      }
+      out << '\n';
+    }
+    return static_cast<bool>(out);
+  });
+  if (!written) {
+    std::cerr << "Could not write tuning database '" << _file << "'." << std::endl;
+  }
+}
+
+}  // namespace mcl
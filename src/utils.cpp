@@ -4,8 +4,19 @@
 
 #include <missocl/utils.h>
 
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 
+#ifdef _WIN32
+#include <process.h>
+#define MCL_GETPID _getpid
+#else
+#include <unistd.h>
+#define MCL_GETPID getpid
+#endif
+
 namespace mcl {
 
 constexpr const char* cl_error(int error_code) {
@@ -155,4 +166,61 @@ void check_opencl_error(cl_int error) {
   }
 }
 
+uint64_t fnv1a_64(std::string_view data, uint64_t hash) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+std::filesystem::path default_cache_directory() {
+  const char* directory = std::getenv("MISSOCL_CACHE_DIR");
+  if (directory == nullptr) {
+    return {};
+  }
+  return {directory};
+}
+
+bool write_file_atomically(const std::filesystem::path& file, const std::function<bool(std::ostream&)>& write,
+                           bool binary) {
+  static std::atomic<uint64_t> counter{0};
+  std::error_code ec;
+  if (file.has_parent_path()) {
+    std::filesystem::create_directories(file.parent_path(), ec);
+  }
+  // process id and a per-process counter: concurrent writers (processes and threads) never share a temporary file
+  auto tmp_file = file;
+  tmp_file += "." + std::to_string(MCL_GETPID()) + "." + std::to_string(counter++) + ".tmp";
+  {
+    std::ofstream out(tmp_file, binary ? std::ios::binary | std::ios::trunc : std::ios::trunc);
+    if (!out) {
+      return false;
+    }
+    if (!write(out) || !out.flush()) {
+      out.close();
+      std::filesystem::remove(tmp_file, ec);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmp_file, file, ec);
+  if (ec) {
+    std::filesystem::remove(tmp_file, ec);
+    return false;
+  }
+  return true;
+}
+
+void read_key_value_file(const std::filesystem::path& file,
+                         const std::function<void(const std::string& key, const std::string& value)>& entry) {
+  std::ifstream in(file);
+  std::string line;
+  while (std::getline(in, line)) {
+    auto tab = line.find('\t');
+    if (tab != std::string::npos) {
+      entry(line.substr(0, tab), line.substr(tab + 1));
+    }
+  }
+}
+
 }
\ No newline at end of file